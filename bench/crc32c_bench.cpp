@@ -0,0 +1,63 @@
+#include "../checksum.hpp"
+#include "../server/file_checksums.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Transfer checksum cost:
+//   ./bench/crc32c_bench [MiB]
+// Compares the CRC32C kernel with memcpy over the same buffer, converts its
+// throughput into CPU share at common line rates, and times the per-download
+// work left once block checksums are stored (combining chunk CRCs).
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Fn>
+double best_seconds(int rounds, Fn&& fn) {
+    double best = 1e30;
+    for (int i = 0; i < rounds; i++) {
+        auto start = Clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    size_t mib = argc > 1 ? atol(argv[1]) : 256;
+    size_t len = mib * 1024 * 1024;
+    std::vector<char> src(len), dst(len);
+    for (size_t i = 0; i < len; i++) src[i] = (char)(i * 2654435761u >> 24);
+
+    volatile uint32_t sink = 0;
+    double t_memcpy = best_seconds(3, [&] { memcpy(dst.data(), src.data(), len); });
+    double t_crc = best_seconds(3, [&] { sink = crc32c_update(0, src.data(), len); });
+    double t_blocks = best_seconds(3, [&] {
+        FileChecksums sums;
+        for (size_t off = 0; off < len; off += 64 * 1024) sums.update(src.data() + off, std::min<size_t>(64 * 1024, len - off));
+        sums.finish();
+        sink = sums.whole;
+    });
+
+    double gb = len / 1e9;
+    printf("buffer: %zu MiB, crc32c kernel: %s\n", mib, crc32c_impl_name());
+    printf("memcpy:                 %6.2f GB/s\n", gb / t_memcpy);
+    printf("crc32c_update:          %6.2f GB/s\n", gb / t_crc);
+    printf("upload (block sums):    %6.2f GB/s\n", gb / t_blocks);
+    for (double gbit : {1.0, 10.0, 25.0}) {
+        printf("CPU share at %4.0f GbE:  %5.1f%% of one core\n", gbit, 100.0 * (gbit / 8) / (gb / t_blocks));
+    }
+
+    // Download path: a 1 GiB file's stored block sums combined into chunk CRCs.
+    FileChecksums big;
+    big.size = 1ull << 30;
+    big.blocks.assign(big.size / FileChecksums::BLOCK, 0x12345678);
+    for (int streams : {2, 8}) {
+        size_t chunk = big.size / streams;
+        double t = best_seconds(5, [&] { sink = big.chunks(chunk).front(); });
+        printf("chunk CRCs, 1 GiB / %d streams: %.3f ms\n", streams, t * 1000);
+    }
+    return sink == 0x5eed ? 1 : 0;
+}
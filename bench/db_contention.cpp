@@ -0,0 +1,105 @@
+#include "../server/db.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Database lock contention:
+//   ./bench/db_contention [seconds] [readers]
+// Seeds a database with 200 games and 10k users in a temporary directory, then
+// runs reader threads (98% login + owner lookups, 2% get_games) against one
+// writer (record_download + record_play_history, sync durability) and reports
+// the rate each side sustained.
+
+static const int GAMES = 200;
+static const int USERS = 10000;
+
+using Clock = std::chrono::steady_clock;
+
+static std::string game_name(int i) { return "game" + std::to_string(i); }
+static std::string user_name(int i) { return "user" + std::to_string(i); }
+
+static void seed(const std::string& path) {
+    json doc;
+    doc["games"] = json::array();
+    doc["users"] = json::array();
+    for (int i = 0; i < GAMES; i++) {
+        doc["games"].push_back({{"name", game_name(i)}, {"dev", "dev" + std::to_string(i % 20)},
+                                {"version", "1.0"}, {"game_type", "CLI"}, {"max_players", 2},
+                                {"description", "benchmark game"}, {"filename", game_name(i) + ".py"}});
+    }
+    for (int i = 0; i < USERS; i++) {
+        doc["users"].push_back({{"username", user_name(i)}, {"password", "pw"}, {"role", "player"}});
+    }
+    std::ofstream(path) << doc.dump();
+}
+
+int main(int argc, char* argv[]) {
+    double seconds = argc > 1 ? atof(argv[1]) : 3;
+    int readers = argc > 2 ? atoi(argv[2]) : 4;
+
+    char dir[] = "/tmp/db_contention.XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    DbOptions opts;
+    opts.json_path = std::string(dir) + "/database.json";
+    opts.snapshot_format = "json";
+    seed(opts.json_path);
+
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> reads{0}, lists{0}, writes{0};
+    {
+        Database db(opts);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < readers; t++) {
+            threads.emplace_back([&, t] {
+                unsigned seed = 12345 + t;
+                std::string role;
+                while (!done) {
+                    int r = rand_r(&seed);
+                    if (r % 100 < 2) {
+                        db.get_games();
+                        lists++;
+                    } else {
+                        db.login_user(user_name(r % USERS), "pw", role);
+                        db.get_game_owner(game_name(r % GAMES));
+                        reads++;
+                    }
+                }
+            });
+        }
+        threads.emplace_back([&] {
+            unsigned seed = 1;
+            while (!done) {
+                int r = rand_r(&seed);
+                std::string game = game_name(r % GAMES), user = user_name(r % USERS);
+                db.record_download(game, user);
+                db.record_play_history(user, game);
+                writes += 2;
+            }
+        });
+
+        auto start = Clock::now();
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        done = true;
+        for (auto& t : threads) t.join();
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+        printf("%d readers, 1 writer, %.1f s\n", readers, elapsed);
+        printf("  reads   %10.0f /s  (login + owner lookup)\n", reads / elapsed);
+        printf("  lists   %10.0f /s  (get_games)\n", lists / elapsed);
+        printf("  writes  %10.0f /s  (record_download, record_play_history)\n", writes / elapsed);
+    }
+
+    std::string base = std::string(dir) + "/database";
+    for (const char* suffix : {".json", ".snap", ".wal", ".wal.old"}) remove((base + suffix).c_str());
+    rmdir(dir);
+    return 0;
+}
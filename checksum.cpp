@@ -0,0 +1,175 @@
+#include "checksum.hpp"
+#include <fstream>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <nmmintrin.h>
+    #define CRC32C_X86 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    #include <arm_acle.h>
+    #define CRC32C_ARM 1
+#endif
+
+#define CRC32C_POLY 0x82F63B78u
+
+struct Crc32cTables {
+    uint32_t t[8][256];
+
+    Crc32cTables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c >> 1) ^ (CRC32C_POLY & (0u - (c & 1)));
+            t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int s = 1; s < 8; s++) t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+        }
+    }
+};
+
+// Function-local statics, so checksums work from other files' static initializers.
+static const Crc32cTables& crc_tables() {
+    static const Crc32cTables tables;
+    return tables;
+}
+
+static uint32_t crc32c_scalar(uint32_t crc, const unsigned char* p, size_t len) {
+    const auto& t = crc_tables().t;
+    while (len > 0 && ((uintptr_t)p & 7)) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+        len--;
+    }
+    while (len >= 8) {
+        uint32_t lo = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+        uint32_t hi = (uint32_t)p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+    return crc;
+}
+
+#if defined(CRC32C_X86)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char* p, size_t len) {
+    while (len > 0 && ((uintptr_t)p & 7)) {
+        crc = _mm_crc32_u8(crc, *p++);
+        len--;
+    }
+#if defined(__x86_64__)
+    uint64_t c64 = crc;
+    while (len >= 8) {
+        uint64_t v;
+        __builtin_memcpy(&v, p, 8);
+        c64 = _mm_crc32_u64(c64, v);
+        p += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)c64;
+#endif
+    while (len >= 4) {
+        uint32_t v;
+        __builtin_memcpy(&v, p, 4);
+        crc = _mm_crc32_u32(crc, v);
+        p += 4;
+        len -= 4;
+    }
+    while (len-- > 0) crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+
+static bool cpu_has_crc32c() {
+    return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(CRC32C_ARM)
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char* p, size_t len) {
+    while (len >= 8) {
+        uint64_t v;
+        __builtin_memcpy(&v, p, 8);
+        crc = __crc32cd(crc, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) crc = __crc32cb(crc, *p++);
+    return crc;
+}
+
+static bool cpu_has_crc32c() {
+    return true;
+}
+#endif
+
+using Crc32cFn = uint32_t (*)(uint32_t, const unsigned char*, size_t);
+
+static Crc32cFn pick_crc32c() {
+#if defined(CRC32C_X86) || defined(CRC32C_ARM)
+    if (cpu_has_crc32c()) return crc32c_hw;
+#endif
+    return crc32c_scalar;
+}
+
+static Crc32cFn crc32c_impl() {
+    static const Crc32cFn impl = pick_crc32c();
+    return impl;
+}
+
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t len) {
+    return ~crc32c_impl()(~crc, (const unsigned char*)data, len);
+}
+
+// Combining multiplies crc(A) by x^(8 * len(B)) modulo the CRC polynomial
+// (zlib's method): multmodp() is that product in the reflected bit order, and
+// the table holds x^(2^k) so any power takes one product per set bit.
+static uint32_t multmodp(uint32_t a, uint32_t b) {
+    uint32_t m = 1u << 31, p = 0;
+    while (true) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) break;
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return p;
+}
+
+struct Crc32cPowers {
+    uint32_t x2n[32];
+
+    Crc32cPowers() {
+        uint32_t p = 1u << 30;  // x^1
+        x2n[0] = p;
+        for (int n = 1; n < 32; n++) x2n[n] = p = multmodp(p, p);
+    }
+};
+
+static uint32_t x8nmodp(size_t len) {
+    static const Crc32cPowers powers;
+    uint32_t p = 1u << 31;  // x^0
+    for (unsigned k = 3; len > 0; len >>= 1, k++) {
+        if (len & 1) p = multmodp(powers.x2n[k & 31], p);
+    }
+    return p;
+}
+
+uint32_t crc32c_combine(uint32_t crc_a, uint32_t crc_b, size_t len_b) {
+    return multmodp(x8nmodp(len_b), crc_a) ^ crc_b;
+}
+
+bool crc32c_file(const std::string& path, uint32_t& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+
+    char buffer[65536];
+    uint32_t crc = 0;
+    while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
+        crc = crc32c_update(crc, buffer, in.gcount());
+    }
+    out = crc;
+    return true;
+}
+
+const char* crc32c_impl_name() {
+    return crc32c_impl() == crc32c_scalar ? "scalar" : "hardware";
+}
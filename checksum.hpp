@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// CRC32C (Castagnoli). Chainable: pass the previous result to continue a stream,
+// starting from 0. Uses SSE4.2 / ARMv8 CRC instructions when the CPU has them.
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t len);
+
+bool crc32c_file(const std::string& path, uint32_t& out);
+
+const char* crc32c_impl_name();
+
+// CRC32C of A followed by B, given crc(A), crc(B) and B's length, without
+// reading either again.
+uint32_t crc32c_combine(uint32_t crc_a, uint32_t crc_b, size_t len_b);
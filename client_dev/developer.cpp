@@ -1,11 +1,14 @@
 #include "../basic.hpp"
 #include "../json.hpp"
+#include "../checksum.hpp"
 
 #include <iostream>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <limits>
+#include <ctime>
+#include <iomanip>
 #include <filesystem>
 #include <sys/stat.h>
 
@@ -86,26 +89,16 @@ bool send_file_data(int port, std::string filepath, long filesize) {
 
 json fetch_my_games() {
     json req;
-    req["action"] = "list_games";
+    req["action"] = "list_my_games";
     send_message(sockfd, req.dump());
 
     std::string res_str;
     if (!recv_message(sockfd, res_str)) return json::array();
 
     json res = json::parse(res_str);
-    if (res["status"] != "ok") return json::array();
+    if (res["status"] != "ok" || !res.contains("data") || !res["data"].is_array()) return json::array();
 
-    json my_games = json::array();
-
-    if (res.contains("data") && res["data"].is_array()) {
-        for (const auto &g : res["data"]) {
-            if (g.value("dev", "") == current_user) {
-                my_games.push_back(g);
-            }
-        }
-    }
-
-    return my_games;
+    return res["data"];
 }
 
 void do_remove_game() {
@@ -290,6 +283,8 @@ void do_upload_new() {
         req["max_players"] = max_players;
         req["filename"] = filename;
         req["filesize"] = filesize;
+        uint32_t crc;
+        if (crc32c_file(filepath, crc)) req["crc32c"] = crc;
 
         if (!send_message(sockfd, req.dump())) {
             std::cout << "[Error] Connection lost." << std::endl;
@@ -500,6 +495,8 @@ void do_update_game() {
             req["max_players"] = new_max_players;
             req["filename"] = filename;
             req["filesize"] = filesize;
+            uint32_t crc;
+            if (crc32c_file(filepath, crc)) req["crc32c"] = crc;
 
             if (!send_message(sockfd, req.dump())) {
                 std::cout << "[Error] Connection lost." << std::endl;
@@ -554,6 +551,13 @@ void do_list_my_games_ui() {
             std::cout << "Version: " << g.value("version", "1.0") << std::endl;
             std::cout << "File: " << g.value("filename", "??") << std::endl;
             std::cout << "Desc: " << g.value("description", "") << std::endl;
+            std::cout << "Downloads: " << g.value("downloads", 0)
+                      << " | Rating: " << g.value("avg_rating", 0.0f) << " (" << g.value("comment_count", 0) << " ratings)"
+                      << std::endl;
+            json day = g.value("activity", json::object()).value("last_24h", json::object());
+            std::cout << "Last 24h: " << day.value("downloads", 0) << " downloads, "
+                      << day.value("matches_finished", 0) << " matches, "
+                      << day.value("players", 0) << " new players" << std::endl;
             std::cout << "--------------------------" << std::endl;
         }
     }
@@ -562,6 +566,101 @@ void do_list_my_games_ui() {
     read_line();
 }
 
+// Prints the buckets of one game_stats series that saw any activity.
+void print_stats_table(const json& series, const char* time_format, bool utc) {
+    static const char* metrics[] = {"downloads", "players", "matches_started", "matches_finished", "ratings"};
+    static const char* headers[] = {"Downloads", "Players", "Started", "Finished", "Ratings"};
+    static const int widths[] = {11, 9, 9, 10, 9};
+    std::cout << std::left << std::setw(18) << "Time" << std::right;
+    for (int m = 0; m < 5; m++) std::cout << std::setw(widths[m]) << headers[m];
+    std::cout << std::endl;
+
+    long start = series.value("start", 0L), step = series.value("step", 3600L);
+    size_t buckets = series.value("downloads", json::array()).size();
+    long totals[5] = {0, 0, 0, 0, 0};
+    bool any = false;
+    for (size_t i = 0; i < buckets; i++) {
+        long counts[5], sum = 0;
+        for (int m = 0; m < 5; m++) {
+            counts[m] = series[metrics[m]][i].get<long>();
+            totals[m] += counts[m];
+            sum += counts[m];
+        }
+        if (sum == 0) continue;
+        any = true;
+
+        time_t t = start + (long)i * step;
+        char label[32];
+        strftime(label, sizeof(label), time_format, utc ? gmtime(&t) : localtime(&t));
+        std::cout << std::left << std::setw(18) << label << std::right;
+        for (int m = 0; m < 5; m++) std::cout << std::setw(widths[m]) << counts[m];
+        std::cout << std::endl;
+    }
+    if (!any) std::cout << "(no activity)" << std::endl;
+
+    std::cout << std::left << std::setw(18) << "Total" << std::right;
+    for (int m = 0; m < 5; m++) std::cout << std::setw(widths[m]) << totals[m];
+    std::cout << std::endl;
+}
+
+void do_game_stats_ui() {
+    clear_screen();
+    std::cout << "=== Game Statistics ===" << std::endl;
+
+    json my_games = fetch_my_games();
+    if (my_games.empty()) {
+        std::cout << "[Info] You have no published games." << std::endl;
+        std::cout << "Press Enter to return...";
+        read_line();
+        return;
+    }
+
+    for (size_t i = 0; i < my_games.size(); ++i) {
+        std::cout << (i + 1) << ". " << my_games[i]["name"].get<std::string>() << std::endl;
+    }
+    std::cout << "0. Cancel" << std::endl;
+    std::cout << "Select game (Number): ";
+
+    std::string input = read_line();
+    if (input == "0" || input.empty()) return;
+
+    size_t idx;
+    try {
+        idx = std::stoi(input);
+    } catch (...) {
+        return;
+    }
+    if (idx < 1 || idx > my_games.size()) return;
+    std::string gamename = my_games[idx - 1]["name"];
+
+    json req;
+    req["action"] = "game_stats";
+    req["game_name"] = gamename;
+    send_message(sockfd, req.dump());
+
+    std::string res_str;
+    if (!recv_message(sockfd, res_str)) return;
+    json res = json::parse(res_str);
+
+    clear_screen();
+    if (res.value("status", "") != "ok") {
+        std::cout << "[Error] " << res.value("message", "Unknown Error") << std::endl;
+    } else {
+        const json& data = res["data"];
+        std::cout << "=== Statistics: " << gamename << " ===" << std::endl;
+        std::cout << "Lifetime downloads (unique players): " << data.value("lifetime_downloads", 0) << std::endl;
+        std::cout << "Players = players finishing their first match of this game.\n" << std::endl;
+
+        std::cout << "--- Hourly ---" << std::endl;
+        print_stats_table(data["hourly"], "%m-%d %H:00", false);
+        std::cout << "\n--- Daily (UTC) ---" << std::endl;
+        print_stats_table(data["daily"], "%Y-%m-%d", true);
+    }
+
+    std::cout << "\nPress Enter to return...";
+    read_line();
+}
+
 bool is_valid_string(const std::string& s) {
     return s.find_first_not_of(" \t\n\v\f\r") != std::string::npos;
 }
@@ -658,15 +757,17 @@ void do_main_menu() {
     std::cout << "2. Upload New Game" << std::endl;
     std::cout << "3. Update Existing Game" << std::endl;
     std::cout << "4. Remove Game" << std::endl;
-    std::cout << "5. Logout" << std::endl;
-    std::cout << "Select(1-5): ";
+    std::cout << "5. Game Statistics" << std::endl;
+    std::cout << "6. Logout" << std::endl;
+    std::cout << "Select(1-6): ";
 
     std::string input = read_line();
     if (input == "1") do_list_my_games_ui();
     else if (input == "2") do_upload_new();
     else if (input == "3") do_update_game();
     else if (input == "4") do_remove_game();
-    else if (input == "5") {
+    else if (input == "5") do_game_stats_ui();
+    else if (input == "6") {
         json req;
         req["action"] = "logout";
         send_message(sockfd, req.dump());
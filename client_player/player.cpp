@@ -1,5 +1,7 @@
 #include "../basic.hpp"
 #include "../json.hpp"
+#include "../codec.hpp"
+#include "../checksum.hpp"
 
 #include <iostream>
 #include <string>
@@ -7,6 +9,12 @@
 #include <sstream>
 #include <fstream>
 #include <filesystem>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <fcntl.h>
 #include <sys/select.h>
 #include <unistd.h>
 
@@ -15,6 +23,8 @@ namespace fs = std::filesystem;
 
 #define SERVER_IP "140.113.17.11"
 #define SERVER_PORT 10988
+#define DEFAULT_DOWNLOAD_STREAMS 4
+#define COMMENTS_PAGE_SIZE 5
 
 enum class ClientState { LOGIN, LOBBY, IN_ROOM };
 
@@ -123,12 +133,85 @@ void do_rate_game(const json& game_info) {
     sleep(2);
 }
 
+int requested_download_streams() {
+    const char* env = getenv("GAMESTORE_DOWNLOAD_STREAMS");
+    if (env) {
+        int n = atoi(env);
+        if (n > 0) return n;
+    }
+    return DEFAULT_DOWNLOAD_STREAMS;
+}
+
+int connect_data_channel(int port) {
+    int data_sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(port);
+    inet_pton(AF_INET, SERVER_IP, &serv_addr.sin_addr);
+
+    if (connect(data_sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
+        close(data_sock);
+        return -1;
+    }
+    return data_sock;
+}
+
+void fetch_chunk(int port, int fd, int idx, int streams, long offset, long length,
+                 StreamDecoder* decoder, const uint32_t* expected_crc,
+                 std::atomic<long>& received, bool& ok) {
+    ok = false;
+    int data_sock = connect_data_channel(port);
+    if (data_sock < 0) return;
+
+    if (streams > 1) {
+        uint32_t net_idx = htonl(idx);
+        if (!send_raw_data(data_sock, (const char*)&net_idx, sizeof(net_idx))) {
+            close(data_sock);
+            return;
+        }
+    }
+
+    auto write_decoded = [fd](const char* data, size_t len) {
+        return write(fd, data, len) == (ssize_t)len;
+    };
+
+    char buffer[65536];
+    long done = 0;
+    uint32_t crc = 0;
+    while (done < length) {
+        size_t to_recv = std::min<long>(sizeof(buffer), length - done);
+        if (!recv_raw_data(data_sock, buffer, to_recv)) break;
+        crc = crc32c_update(crc, buffer, to_recv);
+        if (decoder) {
+            if (!decoder->feed(buffer, to_recv, write_decoded)) break;
+        } else if (pwrite(fd, buffer, to_recv, offset + done) != (ssize_t)to_recv) {
+            break;
+        }
+        done += to_recv;
+        received += to_recv;
+    }
+    close(data_sock);
+
+    ok = (done == length) && (!decoder || decoder->finished());
+    if (ok && expected_crc && crc != *expected_crc) {
+        std::cout << "\n[Error] Chunk " << idx << " checksum mismatch.";
+        ok = false;
+    }
+}
+
 bool download_game_blocking(std::string game_name, std::string server_ver = "") {
     std::cout << "[Auto-Download] Checking game: " << game_name << "...\n";
 
     json req = {
         {"action", "download_request"},
-        {"gamename", game_name}};
+        {"gamename", game_name},
+        {"streams", requested_download_streams()},
+        {"accept_encoding", json::array()}};
+    for (Encoding enc : supported_encodings()) {
+        req["accept_encoding"].push_back(encoding_name(enc));
+    }
     send_message(sockfd, req.dump());
 
     std::string res_str;
@@ -145,46 +228,98 @@ bool download_game_blocking(std::string game_name, std::string server_ver = "")
     int data_port = res["port"];
     long filesize = res["filesize"];
     std::string filename = res["filename"];
+    int streams = res.value("streams", 1);
+    long chunk_size = res.value("chunk_size", filesize);
+    long raw_size = res.value("raw_size", filesize);
+
+    Encoding encoding = Encoding::IDENTITY;
+    if (!parse_encoding(res.value("encoding", "identity"), encoding)) {
+        std::cout << "[Error] Unsupported encoding from server.\n";
+        return false;
+    }
 
     std::cout << "[Auto-Download] Fetching " << filename
-              << " (" << filesize << " bytes)...\n";
+              << " (" << filesize << " bytes " << encoding_name(encoding)
+              << ", " << streams << " streams)...\n";
 
     std::string user_dir = "client_player/downloads/" + current_user;
     ensure_directory_exists(user_dir);
 
     std::string save_path = user_dir + "/" + filename;
+    std::string part_path = save_path + ".part";
+
+    // A single encoded stream is decoded while it is written; encoded chunks
+    // are reassembled first and decoded afterwards.
+    bool inline_decode = (encoding != Encoding::IDENTITY && streams == 1);
+    std::string recv_path = part_path;
+    if (encoding != Encoding::IDENTITY && !inline_decode) {
+        recv_path = part_path + "." + encoding_name(encoding);
+    }
 
-    int data_sock = socket(AF_INET, SOCK_STREAM, 0);
-
-    struct sockaddr_in serv_addr;
-    memset(&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(data_port);
-    inet_pton(AF_INET, SERVER_IP, &serv_addr.sin_addr);
-
-    if (connect(data_sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
-        std::cout << "[Error] Data connection failed.\n";
-        close(data_sock);
+    int fd = open(recv_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || (!inline_decode && ftruncate(fd, filesize) != 0)) {
+        std::cout << "[Error] Cannot create " << recv_path << "\n";
+        if (fd >= 0) close(fd);
         return false;
     }
+    std::unique_ptr<StreamDecoder> decoder;
+    if (inline_decode) decoder.reset(new StreamDecoder(encoding));
+
+    std::vector<uint32_t> chunk_crcs;
+    if (streams > 1 && res.contains("chunk_crc32c")) {
+        chunk_crcs = res["chunk_crc32c"].get<std::vector<uint32_t>>();
+    } else if (streams == 1 && res.contains("crc32c")) {
+        chunk_crcs.push_back(res["crc32c"].get<uint32_t>());
+    }
+    if (!chunk_crcs.empty() && chunk_crcs.size() != (size_t)streams) chunk_crcs.clear();
+
+    std::atomic<long> total_received{0};
+    std::vector<std::thread> workers;
+    std::unique_ptr<bool[]> chunk_ok(new bool[streams]());
+
+    for (int i = 0; i < streams; ++i) {
+        long offset = std::min<long>((long)i * chunk_size, filesize);
+        long length = std::min<long>(chunk_size, filesize - offset);
+        workers.emplace_back(fetch_chunk, data_port, fd, i, streams, offset, length,
+                             decoder.get(), chunk_crcs.empty() ? nullptr : &chunk_crcs[i],
+                             std::ref(total_received), std::ref(chunk_ok[i]));
+    }
 
-    std::ofstream outfile(save_path, std::ios::binary);
-    char buffer[4096];
-    long total_received = 0;
+    std::atomic<bool> finished{false};
+    std::thread progress([&]() {
+        while (!finished) {
+            if (filesize > 0)
+                std::cout << "\rProgress: " << (total_received * 100 / filesize) << "%" << std::flush;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    });
+
+    for (auto &w : workers) w.join();
+    finished = true;
+    progress.join();
+    close(fd);
+
+    bool all_ok = true;
+    for (int i = 0; i < streams; ++i) {
+        if (!chunk_ok[i]) {
+            std::cout << "\n[Error] Chunk " << i << " failed.";
+            all_ok = false;
+        }
+    }
+    std::cout << "\n";
+    all_ok = all_ok && total_received == filesize;
 
-    while (total_received < filesize) {
-        size_t to_recv = std::min<long>(sizeof(buffer), filesize - total_received);
-        if (!recv_raw_data(data_sock, buffer, to_recv)) break;
-        outfile.write(buffer, to_recv);
-        total_received += to_recv;
-        std::cout << "\rProgress: " << (total_received * 100 / filesize) << "%" << std::flush;
+    if (all_ok && recv_path != part_path) {
+        all_ok = decompress_file(recv_path, part_path, encoding);
     }
+    if (recv_path != part_path) remove(recv_path.c_str());
 
-    std::cout << "\n";
-    outfile.close();
-    close(data_sock);
+    if (all_ok && get_file_size(part_path) != raw_size) {
+        std::cout << "[Error] Size mismatch after decoding.\n";
+        all_ok = false;
+    }
 
-    if (total_received == filesize) {
+    if (all_ok && rename(part_path.c_str(), save_path.c_str()) == 0) {
         std::cout << "[Success] Game downloaded.\n";
         if (!server_ver.empty()) {
             std::string v_path = "client_player/downloads/" + current_user + "/" + game_name + ".ver";
@@ -193,22 +328,85 @@ bool download_game_blocking(std::string game_name, std::string server_ver = "")
         }
         return true;
     }
+    remove(part_path.c_str());
     return false;
 }
 
-void show_game_store_interactive() {
-    std::cout << "\n[System] Connecting to Store...\n";
-    json req = {{"action", "list_games"}};
+json fetch_comments(const std::string& game_name, const std::string& sort, int offset) {
+    json req = {
+        {"action", "get_comments"},
+        {"game_name", game_name},
+        {"sort", sort},
+        {"offset", offset},
+        {"limit", COMMENTS_PAGE_SIZE}
+    };
     send_message(sockfd, req.dump());
-    
+
     std::string res_str;
-    if (!recv_message(sockfd, res_str)) return;
+    if (!recv_message(sockfd, res_str)) return nullptr;
     json res = json::parse(res_str);
-    json games = res["data"];
+    if (res.value("status", "") != "ok") return nullptr;
+    return res["data"];
+}
+
+void print_comments(const json& page) {
+    if (page.is_null() || page["comments"].empty()) {
+        std::cout << "(No comments yet)" << std::endl;
+        return;
+    }
+    for (const auto& c : page["comments"]) {
+        std::cout << c["user"] << ": " << c["score"] << "/5 - " << c["content"] << std::endl;
+    }
+}
+
+void browse_comments(const std::string& game_name) {
+    std::string sort = "newest";
+    int offset = 0;
+
+    while (true) {
+        clear_screen();
+        json page = fetch_comments(game_name, sort, offset);
+        int total = page.is_null() ? 0 : page.value("total", 0);
+
+        std::cout << "=== Comments: " << game_name << " ("
+                  << (sort == "score" ? "Highest rated" : "Newest") << " first) ===" << std::endl;
+        print_comments(page);
+        if (total > 0) {
+            std::cout << "\n[" << offset + 1 << "-" << std::min(offset + COMMENTS_PAGE_SIZE, total)
+                      << " of " << total << "]" << std::endl;
+        }
+
+        std::cout << "\nn. Next Page  p. Previous Page  s. Toggle Sort  0. Back\nSelect: ";
+        std::string input = read_line();
+        if (input == "0") break;
+        else if (input == "n" && offset + COMMENTS_PAGE_SIZE < total) offset += COMMENTS_PAGE_SIZE;
+        else if (input == "p") offset = std::max(0, offset - COMMENTS_PAGE_SIZE);
+        else if (input == "s") {
+            sort = (sort == "newest") ? "score" : "newest";
+            offset = 0;
+        }
+    }
+}
+
+json fetch_store_games(const json& req) {
+    send_message(sockfd, req.dump());
+
+    std::string res_str;
+    if (!recv_message(sockfd, res_str)) return nullptr;
+    json res = json::parse(res_str);
+    return res["data"];
+}
+
+void show_game_store_interactive() {
+    std::cout << "\n[System] Connecting to Store...\n";
+    std::string heading;
+    json games = fetch_store_games({{"action", "list_games"}});
+    if (games.is_null()) return;
 
     while (true) {
         clear_screen();
         std::cout << "=== Game Store ===\n";
+        if (!heading.empty()) std::cout << heading << "\n";
         for (size_t i = 0; i < games.size(); ++i) {
             std::string name = games[i]["name"];
             std::string s_ver = games[i].value("version", "1.0");
@@ -224,10 +422,35 @@ void show_game_store_interactive() {
                       << " (Rating: " << games[i].value("avg_rating", 0.0) 
                       << " | DL: " << dl_count << ")" << std::endl;
         }
-        std::cout << "0. Back\nSelect: ";
+        std::cout << "s. Search  t. Top Charts  r. Recommended  0. Back\nSelect: ";
         
         std::string input = read_line();
         if (input == "0") break;
+        if (input == "s" || input == "t" || input == "r") {
+            json req = {{"action", "list_games"}};
+            heading = "";
+            if (input == "s") {
+                std::cout << "Search (empty for all games): ";
+                std::string query = read_line();
+                if (!query.empty()) {
+                    req = {{"action", "search_games"}, {"query", query}};
+                    heading = "Search: \"" + query + "\"";
+                }
+            } else if (input == "r") {
+                req = {{"action", "recommend"}, {"limit", 10}};
+                heading = "Recommended for You";
+            } else {
+                std::cout << "1. Most Downloaded  2. Top Rated  3. Trending\nSelect: ";
+                std::string pick = read_line();
+                std::string by = pick == "2" ? "rating" : pick == "3" ? "plays" : "downloads";
+                req = {{"action", "top_games"}, {"by", by}};
+                heading = pick == "2" ? "Top Rated" : pick == "3" ? "Trending" : "Most Downloaded";
+            }
+            json found = fetch_store_games(req);
+            if (found.is_null()) return;
+            games = found;
+            continue;
+        }
 
         try {
             size_t idx = std::stoi(input);
@@ -242,19 +465,24 @@ void show_game_store_interactive() {
             std::cout << "Version: " << g.value("version", "1.0") << std::endl;
             std::cout << "Description: " << g.value("description", "None") << std::endl;
             
-            std::cout << "\n--- Ratings & Comments (" << g.value("avg_rating", 0.0) << "/5.0) ---" << std::endl;
-            if (g.contains("comments")) {
-                for (const auto& c : g["comments"]) {
-                    std::cout << c["user"] << ": " << c["score"] << "/5 - " << c["content"] << std::endl;
+            std::cout << "\n--- Ratings & Comments (" << g.value("avg_rating", 0.0) << "/5.0, "
+                      << g.value("comment_count", 0) << " reviews) ---" << std::endl;
+            print_comments(fetch_comments(g["name"], "newest", 0));
+
+            json also = fetch_store_games({{"action", "recommend"}, {"game_name", g["name"]}});
+            if (also.is_array() && !also.empty()) {
+                std::cout << "\nPlayers who played this also played: ";
+                for (size_t i = 0; i < also.size(); ++i) {
+                    std::cout << (i ? ", " : "") << also[i]["name"].get<std::string>();
                 }
-            } else {
-                std::cout << "(No comments yet)" << std::endl;
+                std::cout << std::endl;
             }
 
             std::cout << "\nActions:" << std::endl;
             std::cout << "1. Download / Update Game" << std::endl;
             std::cout << "2. Rate this Game" << std::endl;
-            std::cout << "3. Back" << std::endl;
+            std::cout << "3. Browse All Comments" << std::endl;
+            std::cout << "4. Back" << std::endl;
             std::cout << "Select: ";
 
             std::string act = read_line();
@@ -263,6 +491,8 @@ void show_game_store_interactive() {
                 read_line();
             } else if (act == "2") {
                 do_rate_game(g);
+            } else if (act == "3") {
+                browse_comments(g["name"]);
             }
 
         } catch (...) {}
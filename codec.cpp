@@ -0,0 +1,217 @@
+#include "codec.hpp"
+#include <fstream>
+#include <cstdio>
+#include <zlib.h>
+
+#ifdef GAMESTORE_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#define CODEC_BUFFER_SIZE 65536
+#define GZIP_WINDOW_BITS (MAX_WBITS + 16)
+
+const char* encoding_name(Encoding enc) {
+    switch (enc) {
+        case Encoding::GZIP: return "gzip";
+        case Encoding::ZSTD: return "zstd";
+        default:             return "identity";
+    }
+}
+
+bool parse_encoding(const std::string& name, Encoding& out) {
+    if (name == "identity") out = Encoding::IDENTITY;
+    else if (name == "gzip") out = Encoding::GZIP;
+    else if (name == "zstd") out = Encoding::ZSTD;
+    else return false;
+    return true;
+}
+
+bool encoding_supported(Encoding enc) {
+#ifndef GAMESTORE_WITH_ZSTD
+    if (enc == Encoding::ZSTD) return false;
+#endif
+    return true;
+}
+
+std::vector<Encoding> supported_encodings() {
+    std::vector<Encoding> list;
+    if (encoding_supported(Encoding::ZSTD)) list.push_back(Encoding::ZSTD);
+    list.push_back(Encoding::GZIP);
+    return list;
+}
+
+struct StreamDecoder::Impl {
+    Encoding enc;
+    bool done = false;
+    bool ok = false;
+    z_stream zs = {};
+#ifdef GAMESTORE_WITH_ZSTD
+    ZSTD_DCtx* zd = nullptr;
+#endif
+};
+
+StreamDecoder::StreamDecoder(Encoding enc) : impl(new Impl) {
+    impl->enc = enc;
+    if (enc == Encoding::GZIP) {
+        impl->ok = inflateInit2(&impl->zs, GZIP_WINDOW_BITS) == Z_OK;
+    }
+#ifdef GAMESTORE_WITH_ZSTD
+    else if (enc == Encoding::ZSTD) {
+        impl->zd = ZSTD_createDCtx();
+        impl->ok = impl->zd != nullptr;
+    }
+#endif
+    else if (enc == Encoding::IDENTITY) {
+        impl->ok = true;
+    }
+}
+
+StreamDecoder::~StreamDecoder() {
+    if (impl->enc == Encoding::GZIP && impl->ok) inflateEnd(&impl->zs);
+#ifdef GAMESTORE_WITH_ZSTD
+    if (impl->zd) ZSTD_freeDCtx(impl->zd);
+#endif
+}
+
+bool StreamDecoder::finished() const {
+    return impl->enc == Encoding::IDENTITY || impl->done;
+}
+
+bool StreamDecoder::feed(const char* data, size_t len, const DecodeSink& sink) {
+    if (!impl->ok) return false;
+    if (impl->enc == Encoding::IDENTITY) return sink(data, len);
+
+    char out[CODEC_BUFFER_SIZE];
+
+    if (impl->enc == Encoding::GZIP) {
+        z_stream& zs = impl->zs;
+        zs.next_in  = (Bytef*)data;
+        zs.avail_in = len;
+        while (zs.avail_in > 0 && !impl->done) {
+            zs.next_out  = (Bytef*)out;
+            zs.avail_out = sizeof(out);
+            int rc = inflate(&zs, Z_NO_FLUSH);
+            if (rc != Z_OK && rc != Z_STREAM_END) return false;
+            size_t produced = sizeof(out) - zs.avail_out;
+            if (produced > 0 && !sink(out, produced)) return false;
+            if (rc == Z_STREAM_END) impl->done = true;
+        }
+        return true;
+    }
+
+#ifdef GAMESTORE_WITH_ZSTD
+    ZSTD_inBuffer in = {data, len, 0};
+    while (in.pos < in.size) {
+        ZSTD_outBuffer ob = {out, sizeof(out), 0};
+        size_t rc = ZSTD_decompressStream(impl->zd, &ob, &in);
+        if (ZSTD_isError(rc)) return false;
+        if (ob.pos > 0 && !sink(out, ob.pos)) return false;
+        impl->done = (rc == 0);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+static bool gzip_compress_stream(std::ifstream& in, std::ofstream& out) {
+    z_stream zs = {};
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, GZIP_WINDOW_BITS, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    char inbuf[CODEC_BUFFER_SIZE];
+    char outbuf[CODEC_BUFFER_SIZE];
+    bool ok = true;
+    int flush = Z_NO_FLUSH;
+
+    while (ok && flush != Z_FINISH) {
+        in.read(inbuf, sizeof(inbuf));
+        zs.next_in  = (Bytef*)inbuf;
+        zs.avail_in = in.gcount();
+        flush = in.eof() ? Z_FINISH : Z_NO_FLUSH;
+
+        do {
+            zs.next_out  = (Bytef*)outbuf;
+            zs.avail_out = sizeof(outbuf);
+            if (deflate(&zs, flush) == Z_STREAM_ERROR) { ok = false; break; }
+            out.write(outbuf, sizeof(outbuf) - zs.avail_out);
+        } while (zs.avail_out == 0);
+    }
+
+    deflateEnd(&zs);
+    return ok && out.good();
+}
+
+#ifdef GAMESTORE_WITH_ZSTD
+static bool zstd_compress_stream(std::ifstream& in, std::ofstream& out) {
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    if (!cctx) return false;
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, 19);
+
+    char inbuf[CODEC_BUFFER_SIZE];
+    char outbuf[CODEC_BUFFER_SIZE];
+    bool ok = true;
+    bool last = false;
+
+    while (ok && !last) {
+        in.read(inbuf, sizeof(inbuf));
+        last = in.eof();
+        ZSTD_inBuffer ib = {inbuf, (size_t)in.gcount(), 0};
+        ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
+
+        bool drained = false;
+        while (!drained) {
+            ZSTD_outBuffer ob = {outbuf, sizeof(outbuf), 0};
+            size_t rc = ZSTD_compressStream2(cctx, &ob, &ib, mode);
+            if (ZSTD_isError(rc)) { ok = false; break; }
+            out.write(outbuf, ob.pos);
+            drained = last ? (rc == 0) : (ib.pos == ib.size);
+        }
+    }
+
+    ZSTD_freeCCtx(cctx);
+    return ok && out.good();
+}
+#endif
+
+bool compress_file(const std::string& src_path, const std::string& dst_path, Encoding enc) {
+    if (!encoding_supported(enc) || enc == Encoding::IDENTITY) return false;
+
+    std::ifstream in(src_path, std::ios::binary);
+    if (!in.is_open()) return false;
+    std::ofstream out(dst_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+
+    bool ok = false;
+    if (enc == Encoding::GZIP) ok = gzip_compress_stream(in, out);
+#ifdef GAMESTORE_WITH_ZSTD
+    else if (enc == Encoding::ZSTD) ok = zstd_compress_stream(in, out);
+#endif
+
+    out.close();
+    if (!ok) remove(dst_path.c_str());
+    return ok;
+}
+
+bool decompress_file(const std::string& src_path, const std::string& dst_path, Encoding enc) {
+    std::ifstream in(src_path, std::ios::binary);
+    if (!in.is_open()) return false;
+    std::ofstream out(dst_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+
+    StreamDecoder decoder(enc);
+    auto sink = [&](const char* data, size_t len) {
+        out.write(data, len);
+        return out.good();
+    };
+
+    char buffer[CODEC_BUFFER_SIZE];
+    bool ok = true;
+    while (ok && (in.read(buffer, sizeof(buffer)) || in.gcount() > 0)) {
+        ok = decoder.feed(buffer, in.gcount(), sink);
+    }
+
+    out.close();
+    return ok && decoder.finished();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+
+enum class Encoding {
+    IDENTITY,
+    GZIP,
+    ZSTD
+};
+
+const char* encoding_name(Encoding enc);
+bool parse_encoding(const std::string& name, Encoding& out);
+bool encoding_supported(Encoding enc);
+
+// Encodings this build can produce and consume, most preferred first.
+std::vector<Encoding> supported_encodings();
+
+bool compress_file(const std::string& src_path, const std::string& dst_path, Encoding enc);
+bool decompress_file(const std::string& src_path, const std::string& dst_path, Encoding enc);
+
+using DecodeSink = std::function<bool(const char* data, size_t len)>;
+
+class StreamDecoder {
+public:
+    explicit StreamDecoder(Encoding enc);
+    ~StreamDecoder();
+
+    bool feed(const char* data, size_t len, const DecodeSink& sink);
+    bool finished() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
@@ -0,0 +1,289 @@
+#pragma once
+#include "../json.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+using json = nlohmann::json;
+
+enum class GameMetric {
+    DOWNLOADS,         // downloads served
+    PLAYERS,           // players finishing their first match of the game
+    MATCHES_STARTED,
+    MATCHES_FINISHED,
+    RATINGS
+};
+
+constexpr size_t GAME_METRICS = 5;
+inline const char* const GAME_METRIC_NAMES[GAME_METRICS] = {
+    "downloads", "players", "matches_started", "matches_finished", "ratings"
+};
+
+// One saved hour or day: its index (hours or days since the epoch) and counts
+// in GameMetric order.
+struct StatBucket {
+    uint32_t index;
+    uint32_t counts[GAME_METRICS];
+};
+
+// Per-game activity counters in two fixed rings, the last HOURS hours and the
+// last DAYS days (UTC). Every cell packs the bucket it counts (high 32 bits)
+// with its count, so recording is one CAS loop that also recycles a slot whose
+// bucket has gone stale; nothing on that path takes a lock or allocates after a
+// game's first event. Queries read the rings directly.
+//
+// Series are found through a three-level table indexed by interned game name.
+// It spans every 32-bit id but only allocates the parts that ids actually
+// reach, and nothing in it is freed while the table lives, so readers need no
+// protection either.
+class GameAnalytics {
+public:
+    static constexpr size_t HOURS = 48;
+    static constexpr size_t DAYS = 30;
+
+private:
+    static constexpr size_t LEAF = 1024;  // series per leaf
+    static constexpr size_t MID = 1024;   // leaves per middle node
+    static constexpr size_t TOP = 4096;   // TOP * MID * LEAF = 2^32 ids
+
+    using Cell = std::atomic<uint64_t>;
+
+    struct Series {
+        Cell hours[HOURS][GAME_METRICS];
+        Cell days[DAYS][GAME_METRICS];
+        std::atomic<bool> dirty{false};
+
+        Series() { clear(); }
+
+        void clear() {
+            for (auto& row : hours) for (auto& c : row) c.store(0, std::memory_order_relaxed);
+            for (auto& row : days) for (auto& c : row) c.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    struct Leaf {
+        std::atomic<Series*> series[LEAF] = {};
+    };
+
+    struct Mid {
+        std::atomic<Leaf*> leaves[MID] = {};
+    };
+
+    std::atomic<Mid*> table[TOP] = {};
+
+    // The node in `slot`, installing a fresh one if it is empty and `create`
+    // is set; of two racing installs one wins and the other is discarded.
+    template <typename T>
+    static T* load(std::atomic<T*>& slot, bool create) {
+        T* node = slot.load(std::memory_order_acquire);
+        if (!node && create) {
+            T* fresh = new T();
+            if (slot.compare_exchange_strong(node, fresh, std::memory_order_acq_rel)) node = fresh;
+            else delete fresh;
+        }
+        return node;
+    }
+
+    Series* find(uint32_t game, bool create) {
+        Mid* mid = load(table[game / (MID * LEAF)], create);
+        if (!mid) return nullptr;
+        Leaf* leaf = load(mid->leaves[game / LEAF % MID], create);
+        if (!leaf) return nullptr;
+        return load(leaf->series[game % LEAF], create);
+    }
+
+    const Series* find(uint32_t game) const {
+        return const_cast<GameAnalytics*>(this)->find(game, false);
+    }
+
+    // Adds `n` to bucket `index`, restarting the cell if it still holds an
+    // older bucket; events for buckets already rotated out are dropped.
+    static void add(Cell& cell, uint32_t index, uint32_t n) {
+        uint64_t cur = cell.load(std::memory_order_relaxed);
+        while (true) {
+            uint32_t held = cur >> 32;
+            if (held > index) return;
+            uint64_t next = held == index ? cur + n : ((uint64_t)index << 32 | n);
+            if (cell.compare_exchange_weak(cur, next, std::memory_order_relaxed)) return;
+        }
+    }
+
+    // Restores a saved count. Counts within a bucket only grow, so keeping the
+    // larger one makes replaying an older copy harmless.
+    static void merge(Cell& cell, uint32_t index, uint32_t count) {
+        uint64_t cur = cell.load(std::memory_order_relaxed);
+        while (true) {
+            uint32_t held = cur >> 32;
+            if (held > index || (held == index && (uint32_t)cur >= count)) return;
+            if (cell.compare_exchange_weak(cur, (uint64_t)index << 32 | count, std::memory_order_relaxed)) return;
+        }
+    }
+
+    static uint32_t count_at(const Cell& cell, uint32_t index) {
+        uint64_t v = cell.load(std::memory_order_relaxed);
+        return (uint32_t)(v >> 32) == index ? (uint32_t)v : 0;
+    }
+
+    template <size_t N>
+    static void save_ring(const Cell (&ring)[N][GAME_METRICS], std::vector<StatBucket>& out) {
+        for (const auto& row : ring) {
+            size_t first = out.size();
+            for (size_t m = 0; m < GAME_METRICS; m++) {
+                uint64_t v = row[m].load(std::memory_order_relaxed);
+                if ((uint32_t)v == 0) continue;
+                uint32_t index = v >> 32;
+                auto it = std::find_if(out.begin() + first, out.end(), [&](const StatBucket& b) { return b.index == index; });
+                if (it == out.end()) it = out.insert(out.end(), StatBucket{index, {}});
+                it->counts[m] = (uint32_t)v;
+            }
+        }
+    }
+
+    template <size_t N>
+    static json ring_json(const Cell (&ring)[N][GAME_METRICS], uint32_t current, uint32_t step) {
+        json j = {{"start", (int64_t)(current - N + 1) * step}, {"step", step}};
+        for (size_t m = 0; m < GAME_METRICS; m++) {
+            std::vector<uint32_t> counts(N);
+            for (size_t i = 0; i < N; i++) {
+                uint32_t index = current - N + 1 + i;
+                counts[i] = count_at(ring[index % N][m], index);
+            }
+            j[GAME_METRIC_NAMES[m]] = counts;
+        }
+        return j;
+    }
+
+    template <size_t N>
+    static json ring_totals(const Cell (&ring)[N][GAME_METRICS], uint32_t current, size_t buckets) {
+        json j;
+        for (size_t m = 0; m < GAME_METRICS; m++) {
+            uint64_t sum = 0;
+            for (uint32_t index = current - buckets + 1; index <= current; index++) sum += count_at(ring[index % N][m], index);
+            j[GAME_METRIC_NAMES[m]] = sum;
+        }
+        return j;
+    }
+
+public:
+    GameAnalytics() = default;
+    GameAnalytics(const GameAnalytics&) = delete;
+    GameAnalytics& operator=(const GameAnalytics&) = delete;
+
+    ~GameAnalytics() {
+        for (auto& top : table) {
+            Mid* mid = top.load();
+            if (!mid) continue;
+            for (auto& slot : mid->leaves) {
+                Leaf* leaf = slot.load();
+                if (!leaf) continue;
+                for (auto& s : leaf->series) delete s.load();
+                delete leaf;
+            }
+            delete mid;
+        }
+    }
+
+    void record(uint32_t game, GameMetric metric, uint32_t n = 1, time_t now = time(nullptr)) {
+        Series* s = find(game, true);
+        size_t m = (size_t)metric;
+        uint32_t hour = now / 3600, day = now / 86400;
+        add(s->hours[hour % HOURS][m], hour, n);
+        add(s->days[day % DAYS][m], day, n);
+        if (!s->dirty.load(std::memory_order_relaxed)) s->dirty.store(true, std::memory_order_relaxed);
+    }
+
+    // A deleted game's counters start over if the name is reused.
+    void clear(uint32_t game) {
+        if (Series* s = find(game, false)) s->clear();
+    }
+
+    // Saved form: non-empty hourly and daily buckets.
+    void save(uint32_t game, std::vector<StatBucket>& hours, std::vector<StatBucket>& days) const {
+        const Series* s = find(game);
+        if (!s) return;
+        save_ring(s->hours, hours);
+        save_ring(s->days, days);
+    }
+
+    void restore(uint32_t game, const StatBucket& b, bool daily) {
+        Series* s = find(game, true);
+        for (size_t m = 0; m < GAME_METRICS; m++) {
+            if (b.counts[m] == 0) continue;
+            if (daily) merge(s->days[b.index % DAYS][m], b.index, b.counts[m]);
+            else merge(s->hours[b.index % HOURS][m], b.index, b.counts[m]);
+        }
+    }
+
+    // {"hours": [[index, counts...], ...], "days": [...]}, as in snapshots and
+    // game_stats log records.
+    json to_json(uint32_t game) const {
+        std::vector<StatBucket> hours, days;
+        save(game, hours, days);
+        auto rows = [](const std::vector<StatBucket>& list) {
+            json out = json::array();
+            for (const auto& b : list) {
+                json row = {b.index};
+                for (uint32_t c : b.counts) row.push_back(c);
+                out.push_back(row);
+            }
+            return out;
+        };
+        return {{"hours", rows(hours)}, {"days", rows(days)}};
+    }
+
+    void restore_json(uint32_t game, const json& j) {
+        for (const char* scale : {"hours", "days"}) {
+            if (!j.contains(scale)) continue;
+            for (const auto& row : j[scale]) {
+                if (!row.is_array() || row.size() != GAME_METRICS + 1) continue;
+                StatBucket b{row[0].get<uint32_t>(), {}};
+                for (size_t m = 0; m < GAME_METRICS; m++) b.counts[m] = row[m + 1].get<uint32_t>();
+                restore(game, b, scale[0] == 'd');
+            }
+        }
+    }
+
+    // Visits every game recorded since the previous call.
+    template <typename Fn>
+    void take_dirty(Fn&& fn) {
+        for (size_t t = 0; t < TOP; t++) {
+            Mid* mid = table[t].load(std::memory_order_acquire);
+            if (!mid) continue;
+            for (size_t m = 0; m < MID; m++) {
+                Leaf* leaf = mid->leaves[m].load(std::memory_order_acquire);
+                if (!leaf) continue;
+                for (size_t i = 0; i < LEAF; i++) {
+                    Series* s = leaf->series[i].load(std::memory_order_acquire);
+                    if (s && s->dirty.exchange(false, std::memory_order_relaxed)) {
+                        fn((uint32_t)((t * MID + m) * LEAF + i));
+                    }
+                }
+            }
+        }
+    }
+
+    // Per-metric sums over the last 24 hours and the last DAYS days.
+    json totals(uint32_t game, time_t now = time(nullptr)) const {
+        static const Series empty;
+        const Series* s = find(game);
+        if (!s) s = &empty;
+        return {
+            {"last_24h", ring_totals(s->hours, now / 3600, 24)},
+            {"last_30d", ring_totals(s->days, now / 86400, DAYS)}
+        };
+    }
+
+    // The hourly and daily series ending at `now`, one array per metric, oldest
+    // bucket first.
+    json query(uint32_t game, time_t now = time(nullptr)) const {
+        static const Series empty;
+        const Series* s = find(game);
+        if (!s) s = &empty;
+        return {
+            {"hourly", ring_json(s->hours, now / 3600, 3600)},
+            {"daily", ring_json(s->days, now / 86400, 86400)}
+        };
+    }
+};
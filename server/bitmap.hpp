@@ -0,0 +1,151 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Roaring-style compressed set of 32-bit ids. Ids are bucketed by their high
+// 16 bits; a bucket holds a sorted array of low halves while small and switches
+// to a 65536-bit bitmap once it passes ARRAY_MAX entries, where the bitmap
+// (8 KiB) becomes the smaller representation.
+class RoaringBitmap {
+private:
+    static constexpr uint32_t ARRAY_MAX = 4096;
+    static constexpr uint32_t BITMAP_WORDS = 65536 / 64;
+
+    struct Container {
+        uint16_t key;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;
+        std::vector<uint64_t> bits;
+
+        bool is_bitmap() const { return !bits.empty(); }
+
+        bool contains(uint16_t low) const {
+            if (is_bitmap()) return (bits[low >> 6] >> (low & 63)) & 1;
+            return std::binary_search(array.begin(), array.end(), low);
+        }
+
+        bool add(uint16_t low) {
+            if (is_bitmap()) {
+                uint64_t mask = (uint64_t)1 << (low & 63);
+                if (bits[low >> 6] & mask) return false;
+                bits[low >> 6] |= mask;
+                cardinality++;
+                return true;
+            }
+            auto it = std::lower_bound(array.begin(), array.end(), low);
+            if (it != array.end() && *it == low) return false;
+            array.insert(it, low);
+            cardinality++;
+            if (cardinality > ARRAY_MAX) to_bitmap();
+            return true;
+        }
+
+        bool remove(uint16_t low) {
+            if (is_bitmap()) {
+                uint64_t mask = (uint64_t)1 << (low & 63);
+                if (!(bits[low >> 6] & mask)) return false;
+                bits[low >> 6] &= ~mask;
+                cardinality--;
+                if (cardinality <= ARRAY_MAX) to_array();
+                return true;
+            }
+            auto it = std::lower_bound(array.begin(), array.end(), low);
+            if (it == array.end() || *it != low) return false;
+            array.erase(it);
+            cardinality--;
+            return true;
+        }
+
+        void to_bitmap() {
+            bits.assign(BITMAP_WORDS, 0);
+            for (uint16_t v : array) bits[v >> 6] |= (uint64_t)1 << (v & 63);
+            std::vector<uint16_t>().swap(array);
+        }
+
+        void to_array() {
+            array.clear();
+            array.reserve(cardinality);
+            for (uint32_t w = 0; w < BITMAP_WORDS; w++) {
+                for (uint64_t word = bits[w]; word; word &= word - 1) {
+                    array.push_back((uint16_t)(w * 64 + __builtin_ctzll(word)));
+                }
+            }
+            std::vector<uint64_t>().swap(bits);
+        }
+
+        template <typename Fn>
+        void for_each(uint32_t high, Fn&& fn) const {
+            if (is_bitmap()) {
+                for (uint32_t w = 0; w < BITMAP_WORDS; w++) {
+                    for (uint64_t word = bits[w]; word; word &= word - 1) {
+                        fn(high | (w * 64 + __builtin_ctzll(word)));
+                    }
+                }
+            } else {
+                for (uint16_t v : array) fn(high | v);
+            }
+        }
+    };
+
+    std::vector<Container> containers;
+
+    std::vector<Container>::iterator find_container(uint16_t key) {
+        return std::lower_bound(containers.begin(), containers.end(), key,
+                                [](const Container& c, uint16_t k) { return c.key < k; });
+    }
+
+    std::vector<Container>::const_iterator find_container(uint16_t key) const {
+        return std::lower_bound(containers.begin(), containers.end(), key,
+                                [](const Container& c, uint16_t k) { return c.key < k; });
+    }
+
+public:
+    // Returns false if `id` was already present.
+    bool add(uint32_t id) {
+        uint16_t key = id >> 16;
+        auto it = find_container(key);
+        if (it == containers.end() || it->key != key) {
+            it = containers.insert(it, Container());
+            it->key = key;
+        }
+        return it->add(id & 0xFFFF);
+    }
+
+    bool remove(uint32_t id) {
+        uint16_t key = id >> 16;
+        auto it = find_container(key);
+        if (it == containers.end() || it->key != key) return false;
+        bool removed = it->remove(id & 0xFFFF);
+        if (it->cardinality == 0) containers.erase(it);
+        return removed;
+    }
+
+    bool contains(uint32_t id) const {
+        uint16_t key = id >> 16;
+        auto it = find_container(key);
+        return it != containers.end() && it->key == key && it->contains(id & 0xFFFF);
+    }
+
+    size_t cardinality() const {
+        size_t n = 0;
+        for (const auto& c : containers) n += c.cardinality;
+        return n;
+    }
+
+    bool empty() const { return containers.empty(); }
+
+    // Visits ids in ascending order.
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        for (const auto& c : containers) c.for_each((uint32_t)c.key << 16, fn);
+    }
+
+    size_t bytes() const {
+        size_t total = sizeof(*this) + containers.capacity() * sizeof(Container);
+        for (const auto& c : containers) {
+            total += c.array.capacity() * sizeof(uint16_t) + c.bits.capacity() * sizeof(uint64_t);
+        }
+        return total;
+    }
+};
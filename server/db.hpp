@@ -1,278 +1,862 @@
 #pragma once
 #include "../json.hpp"
+#include "analytics.hpp"
+#include "bitmap.hpp"
+#include "interner.hpp"
+#include "ranking.hpp"
+#include "recommend.hpp"
+#include "records.hpp"
+#include "rw_lock.hpp"
+#include "search.hpp"
+#include "sqlite_storage.hpp"
+#include "storage.hpp"
+#include <cmath>
+#include <condition_variable>
 #include <fstream>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <iostream>
+#include <memory>
 
 using json = nlohmann::json;
 
-float calculate_rating(const json& comments) {
-    if (comments.empty()) return 0.0f;
-    float sum = 0;
-    for (const auto& c : comments) {
-        sum += c.value("score", 0);
-    }
-    return sum / comments.size();
-}
+struct DbOptions {
+    // "json" (database.json + write-ahead log) or "sqlite".
+    std::string engine = "json";
+    std::string json_path = "database.json";
+    // JSON engine snapshot: "binary" (database.snap, mapped at startup) or "json".
+    std::string snapshot_format = "binary";
+    std::string sqlite_path = "database.sqlite";
+    // While several committers are waiting, mutations arriving within this
+    // window share one write + fsync; a lone committer is flushed at once.
+    long group_commit_window_us = 2000;
+    size_t group_commit_max_records = 256;
+    // "sync": a mutation returns once it is on disk. "async": it returns right
+    // after the in-memory apply and the storage writer flushes at most every
+    // flush_interval_ms, so a crash can lose that last interval.
+    std::string durability = "sync";
+    long flush_interval_ms = 200;
+    // top_games: games need this many ratings to be ranked by average, and a
+    // play counts half as much towards "plays" after each half-life.
+    uint32_t rating_min_votes = 3;
+    double plays_half_life_hours = 72;
+    // Game analytics counters are logged at most this often (and on flush()).
+    long stats_flush_interval_s = 60;
+    // JSON engine only: load the data as it is on disk and never write to it
+    // (no write-ahead log, checkpoints or analytics flushes), e.g. to read a
+    // migration source. Mutations are applied in memory only.
+    bool read_only = false;
+};
 
+// Every mutation is applied in memory and handed to the StorageEngine as one
+// typed record. With the JSON engine a background thread periodically folds the
+// log into a snapshot; startup replays whatever is persisted.
+// Records are held as typed structs with interned names; JSON is only built for
+// the snapshot and for protocol responses.
+//
+// Locking is split into a games shard and a users shard, each behind a
+// FairSharedMutex: readers of a shard run concurrently and a writer blocks only its
+// own shard. Ops on different shards commute, so their relative LSN order does
+// not matter. Lock order: games_mutex, users_mutex, commit_mutex.
 class Database {
 private:
-    const std::string DB_FILE = "database.json";
-    std::mutex db_mutex;
-    json db_data;
+    mutable FairSharedMutex games_mutex;
+    mutable FairSharedMutex users_mutex;
+    std::mutex commit_mutex;
+    uint64_t last_lsn = 0;
+    std::unique_ptr<StorageEngine> storage;
+    bool async_durability = false;
 
-    void load() {
-        std::ifstream in(DB_FILE);
-        if (in.good()) {
-            try {
-                in >> db_data;
-            } catch (...) {
-                std::cerr << "Warning: DB file corrupted or empty, initializing new." << std::endl;
-                db_data = json::object();
+    std::thread compactor;
+    std::condition_variable compact_cv;
+    bool compact_requested = false;
+    bool stopping = false;
+
+    StringInterner& strings = name_interner();
+    std::vector<GameRecord> games;
+    std::vector<UserRecord> users;
+
+    // Positions in games / users keyed by interned name. Appends keep them valid;
+    // deleting a game shifts the vector, so game_index is rebuilt.
+    std::unordered_map<uint32_t, uint32_t> game_index;
+    std::unordered_map<uint32_t, uint32_t> user_index;
+
+    // Game names per developer, maintained under games_mutex.
+    std::unordered_map<uint32_t, RoaringBitmap> dev_games;
+
+    // Full-text index over the catalog, maintained under games_mutex.
+    SearchIndex search_index;
+
+    // top_games orderings keyed by interned game name, maintained under games_mutex.
+    Ranking top_downloads;
+    Ranking top_rated;
+    Ranking top_played;
+    uint32_t rating_min_votes = 3;
+    double plays_lambda = 0;  // per second
+
+    // Co-play counts between games, maintained under users_mutex alongside the
+    // play histories they are derived from.
+    CoPlayIndex coplay;
+    bool coplay_ready = false;
+
+    // Hourly / daily activity counters per game, recorded without locks and
+    // logged as game_stats records every stats_flush_interval.
+    GameAnalytics analytics;
+    std::chrono::seconds stats_flush_interval{60};
+
+    // Serialized list_games response, shared by every request until the
+    // catalog changes. catalog_version only moves under games_mutex.
+    uint64_t catalog_version = 0;
+    uint64_t catalog_built_version = 0;
+    std::shared_ptr<const std::string> catalog;
+    std::mutex catalog_mutex;
+
+    const std::string& str(uint32_t id) const { return strings.str(id); }
+
+    bool in_set(const RoaringBitmap& set, const std::string& key) const {
+        uint32_t id = strings.find(key);
+        return id != StringInterner::NONE && set.contains(id);
+    }
+
+    GameRecord* find_game(const std::string& game_name) {
+        auto it = game_index.find(strings.find(game_name));
+        return it == game_index.end() ? nullptr : &games[it->second];
+    }
+
+    UserRecord* find_user(const std::string& username) {
+        auto it = user_index.find(strings.find(username));
+        return it == user_index.end() ? nullptr : &users[it->second];
+    }
+
+    void index_game(uint32_t pos) {
+        const GameRecord& g = games[pos];
+        game_index.emplace(g.name, pos);
+        dev_games[g.dev].add(g.name);
+        index_search(g);
+        rank_game(g);
+    }
+
+    void index_search(const GameRecord& g) {
+        search_index.add(g.name, str(g.name), str(g.dev), g.description);
+    }
+
+    void rank_game(const GameRecord& g) {
+        top_downloads.set(g.name, g.downloaded_by.cardinality());
+        if (g.rating.count >= rating_min_votes) top_rated.set(g.name, g.rating.average());
+        else top_rated.remove(g.name);
+        if (std::isfinite(g.play_trend)) top_played.set(g.name, g.play_trend);
+    }
+
+    void unrank_game(uint32_t name) {
+        top_downloads.remove(name);
+        top_rated.remove(name);
+        top_played.remove(name);
+    }
+
+    static double now_seconds() {
+        return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // log(e^a + e^b) without overflowing.
+    static double log_add(double a, double b) {
+        if (std::isinf(a)) return b;
+        if (std::isinf(b)) return a;
+        return std::max(a, b) + std::log1p(std::exp(-std::fabs(a - b)));
+    }
+
+    void index_user(uint32_t pos) {
+        const UserRecord& u = users[pos];
+        user_index.emplace(u.username, pos);
+    }
+
+    void rebuild_game_index() {
+        game_index.clear();
+        for (uint32_t i = 0; i < games.size(); i++) game_index.emplace(games[i].name, i);
+    }
+
+    GameRecord game_from_json(const json& j) {
+        GameRecord g;
+        g.name = strings.intern(j.value("name", ""));
+        g.dev = strings.intern(j.value("dev", ""));
+        g.version = strings.intern(j.value("version", ""));
+        g.game_type = strings.intern(j.value("game_type", ""));
+        g.max_players = j.value("max_players", 2);
+        g.downloads = j.value("downloads", 0);
+        g.description = j.value("description", "");
+        g.filename = j.value("filename", "");
+        if (j.contains("comments")) {
+            for (const auto& c : j["comments"]) {
+                int score = c.value("score", 0);
+                if (!RatingAggregate::valid(score)) continue;
+                uint32_t user = strings.intern(c.value("user", ""));
+                g.comments.add({user, score, c.value("content", "")});
+                g.rating.add(score);
+                g.commenters.add(user);
             }
         }
-        if (!db_data.contains("users")) db_data["users"] = json::array();
-        if (!db_data.contains("games")) db_data["games"] = json::array();
+        if (j.contains("downloaded_by")) {
+            for (const auto& u : j["downloaded_by"]) g.downloaded_by.add(strings.intern(u.get<std::string>()));
+        }
+        if (j.contains("play_trend") && j["play_trend"].is_number()) g.play_trend = j["play_trend"];
+        if (j.contains("stats")) analytics.restore_json(g.name, j["stats"]);
+        return g;
     }
 
-    void save() {
-        std::ofstream out(DB_FILE);
-        out << db_data.dump(4);
+    UserRecord user_from_json(const json& j) {
+        UserRecord u;
+        u.username = strings.intern(j.value("username", ""));
+        u.role = strings.intern(j.value("role", ""));
+        u.password = j.value("password", "");
+        if (j.contains("play_history")) {
+            for (const auto& g : j["play_history"]) u.play_history.add(strings.intern(g.get<std::string>()));
+        }
+        return u;
     }
 
-public:
-    Database() { load(); }
+    json comment_json(const Comment& c) const {
+        return {{"user", str(c.user)}, {"score", c.score}, {"content", c.content}};
+    }
 
-    std::string get_game_owner(const std::string& game_name) {
-        std::lock_guard<std::mutex> lock(db_mutex);
-        for (const auto& g : db_data["games"]) {
-            if (g["name"] == game_name) {
-                return g["dev"];
-            }
+    // Catalog entry for list_games: summary fields only. Comments are paged
+    // separately through get_comments, so the catalog does not grow with reviews.
+    json listing_json(const GameRecord& g) const {
+        json j = {
+            {"name", str(g.name)},
+            {"dev", str(g.dev)},
+            {"description", g.description},
+            {"filename", g.filename},
+            {"version", str(g.version)},
+            {"game_type", str(g.game_type)},
+            {"max_players", g.max_players},
+            {"avg_rating", g.rating.average()},
+            {"comment_count", g.rating.count},
+            {"rating_histogram", g.rating.histogram},
+            {"downloads", g.downloaded_by.cardinality()}
+        };
+        return j;
+    }
+
+    json games_json() const {
+        json list = json::array();
+        for (const auto& g : games) {
+            list.push_back(listing_json(g));
         }
-        return "";
+        return list;
     }
 
-    int get_game_max_players(const std::string& game_name) {
-        std::lock_guard<std::mutex> lock(db_mutex);
-        for (const auto& g : db_data["games"]) {
-            if (g["name"] == game_name) {
-                return g.value("max_players", 2);
+    // Binary snapshot of the whole database; caller holds both shard locks and
+    // commit_mutex.
+    std::string encode_snapshot() const {
+        SnapshotWriter writer(strings, last_lsn);
+        for (const auto& u : users) writer.add_user(u);
+        for (const auto& g : games) writer.add_game(g);
+        writer.add_coplay(coplay);
+        for (const auto& g : games) writer.add_stats(g.name, analytics);
+        return writer.finish();
+    }
+
+    void apply(const json& rec) {
+        std::string op = rec["op"];
+        if (op != "register_user" && op != "record_play" && op != "record_plays" && op != "increment_downloads" &&
+            op != "game_stats") {
+            catalog_version++;
+        }
+
+        if (op == "register_user") {
+            users.push_back(user_from_json(rec));
+            index_user(users.size() - 1);
+        }
+        else if (op == "upsert_game") {
+            GameRecord* g = find_game(rec["name"]);
+            // Another developer's title is left alone, as the SQLite engine does.
+            if (g && str(g->dev) != rec["dev"]) return;
+            if (g) {
+                g->description = rec["description"];
+                g->filename = rec["filename"];
+                g->version = strings.intern(rec["version"].get<std::string>());
+                g->game_type = strings.intern(rec["game_type"].get<std::string>());
+                g->max_players = rec["max_players"];
+                index_search(*g);
+                return;
             }
+            games.push_back(game_from_json(rec));
+            index_game(games.size() - 1);
+        }
+        else if (op == "delete_game") {
+            GameRecord* g = find_game(rec["name"]);
+            if (!g || str(g->dev) != rec["dev"]) return;
+            search_index.remove(g->name);
+            unrank_game(g->name);
+            analytics.clear(g->name);
+            if (coplay_ready) coplay.remove_game(g->name);
+            auto dev = dev_games.find(g->dev);
+            if (dev != dev_games.end() && dev->second.remove(g->name) && dev->second.empty()) dev_games.erase(dev);
+            games.erase(games.begin() + (g - games.data()));
+            rebuild_game_index();
+        }
+        else if (op == "add_comment") {
+            GameRecord* g = find_game(rec["game"]);
+            int score = rec["score"];
+            if (!g || !RatingAggregate::valid(score)) return;
+            uint32_t user = strings.intern(rec["user"].get<std::string>());
+            g->comments.add({user, score, rec["content"].get<std::string>()});
+            g->rating.add(score);
+            g->commenters.add(user);
+            rank_game(*g);
+        }
+        else if (op == "record_download") {
+            GameRecord* g = find_game(rec["game"]);
+            if (!g) return;
+            uint32_t user = strings.intern(rec["user"].get<std::string>());
+            g->downloaded_by.add(user);
+            rank_game(*g);
+        }
+        else if (op == "record_play") {
+            UserRecord* u = find_user(rec["user"]);
+            if (!u) return;
+            uint32_t game = strings.intern(rec["game"].get<std::string>());
+            if (u->play_history.contains(game)) return;
+            if (coplay_ready && game_index.count(game)) {
+                coplay.add_play(u->play_history, game, [this](uint32_t other) { return game_index.count(other) > 0; });
+            }
+            u->play_history.add(game);
+        }
+        else if (op == "record_plays") {
+            GameRecord* g = find_game(rec["game"]);
+            if (!g) return;
+            g->play_trend = rec["trend"];
+            rank_game(*g);
+        }
+        else if (op == "increment_downloads") {
+            GameRecord* g = find_game(rec["game"]);
+            if (!g) return;
+            g->downloads++;
+        }
+        else if (op == "game_stats") {
+            GameRecord* g = find_game(rec["game"]);
+            if (!g) return;
+            analytics.restore_json(g->name, rec["stats"]);
         }
-        return 2;
     }
 
-    void increment_download_count(const std::string& game_name) {
-        std::lock_guard<std::mutex> lock(db_mutex);
-        for (auto& g : db_data["games"]) {
-            if (g["name"] == game_name) {
+    // Caller holds the exclusive lock of the shard `rec` touches; it must call
+    // make_durable() on the returned LSN after releasing it.
+    uint64_t commit(json rec) {
+        apply(rec);
+        std::lock_guard<std::mutex> lock(commit_mutex);
+        rec["lsn"] = ++last_lsn;
+        storage->append(last_lsn, rec);
+        if (storage->needs_checkpoint() && !compact_requested) {
+            compact_requested = true;
+            compact_cv.notify_one();
+        }
+        return last_lsn;
+    }
 
-                int current = g.value("downloads", 0);
-                g["downloads"] = current + 1;
-                save();
-                return;
+    void make_durable(uint64_t lsn) {
+        if (!async_durability) storage->wait_durable(lsn);
+    }
+
+    void load() {
+        StorageSink sink;
+        sink.snapshot = [this](const SnapshotReader& reader) {
+            reader.load(strings, users, games, coplay, analytics);
+            coplay_ready = true;
+            for (uint32_t i = 0; i < users.size(); i++) index_user(i);
+            for (uint32_t i = 0; i < games.size(); i++) index_game(i);
+        };
+        sink.json_snapshot = [this](JsonSnapshotLoader& loader) {
+            loader.load(strings, users, games, analytics);
+            for (uint32_t i = 0; i < users.size(); i++) index_user(i);
+            for (uint32_t i = 0; i < games.size(); i++) index_game(i);
+        };
+        sink.user = [this](const json& u) {
+            users.push_back(user_from_json(u));
+            index_user(users.size() - 1);
+        };
+        sink.game = [this](const json& g) {
+            games.push_back(game_from_json(g));
+            index_game(games.size() - 1);
+        };
+        sink.record = [this](const json& rec) { apply(rec); };
+        last_lsn = storage->load(sink);
+
+        // Only a binary snapshot carries the co-play index; otherwise count it
+        // once from the loaded histories.
+        if (!coplay_ready) {
+            std::vector<const RoaringBitmap*> histories;
+            for (const auto& u : users) histories.push_back(&u.play_history);
+            coplay.build(histories, std::thread::hardware_concurrency());
+            coplay_ready = true;
+        }
+
+        // Histories still name deleted games, and older snapshots kept their
+        // rows; the index only covers games in the catalog.
+        std::vector<uint32_t> deleted;
+        coplay.for_each_row([&](uint32_t game, const std::vector<CoPlayCount>&) {
+            if (!game_index.count(game)) deleted.push_back(game);
+        });
+        for (uint32_t game : deleted) coplay.remove_game(game);
+    }
+
+    // Logs the analytics of every game recorded since the last flush. Counters
+    // are read after take_dirty() clears the flag, so nothing recorded in between
+    // is lost; it is only logged twice.
+    void flush_stats() {
+        std::vector<uint32_t> changed;
+        analytics.take_dirty([&](uint32_t game) { changed.push_back(game); });
+        if (changed.empty()) return;
+        uint64_t lsn = 0;
+        {
+            std::unique_lock<FairSharedMutex> lock(games_mutex);
+            for (uint32_t game : changed) {
+                if (game_index.find(game) == game_index.end()) continue;
+                lsn = commit({{"op", "game_stats"}, {"game", str(game)}, {"stats", analytics.to_json(game)}});
             }
         }
+        if (lsn) make_durable(lsn);
     }
 
-    void record_play_history(const std::string& username, const std::string& game_name) {
-        std::lock_guard<std::mutex> lock(db_mutex);
-        
-        for (auto& u : db_data["users"]) {
-            if (u["username"] == username) {
-                if (!u.contains("play_history")) {
-                    u["play_history"] = json::array();
-                }
-                
-                bool played = false;
-                for (const auto& g : u["play_history"]) {
-                    if (g == game_name) { played = true; break; }
-                }
-                
-                if (!played) {
-                    u["play_history"].push_back(game_name);
-                    save();
-                }
-                return;
+    // Runs checkpoints when requested and flushes analytics on a timer.
+    void compact_loop() {
+        auto next_stats_flush = std::chrono::steady_clock::now() + stats_flush_interval;
+        while (true) {
+            bool checkpoint;
+            {
+                std::unique_lock<std::mutex> lock(commit_mutex);
+                compact_cv.wait_until(lock, next_stats_flush, [this] { return compact_requested || stopping; });
+                if (stopping) return;
+                checkpoint = compact_requested;
+                compact_requested = false;
+            }
+            if (std::chrono::steady_clock::now() >= next_stats_flush) {
+                flush_stats();
+                next_stats_flush = std::chrono::steady_clock::now() + stats_flush_interval;
+            }
+            if (!checkpoint) continue;
+
+            std::string image;
+            {
+                std::unique_lock<FairSharedMutex> games_lock(games_mutex);
+                std::unique_lock<FairSharedMutex> users_lock(users_mutex);
+                std::lock_guard<std::mutex> lock(commit_mutex);
+                if (!storage->begin_checkpoint()) continue;
+                image = encode_snapshot();
             }
+            storage->finish_checkpoint(image);
         }
     }
 
-    bool has_played(const std::string& username, const std::string& game_name) {
-        std::lock_guard<std::mutex> lock(db_mutex);
-        for (const auto& u : db_data["users"]) {
-            if (u["username"] == username) {
-                if (u.contains("play_history")) {
-                    for (const auto& g : u["play_history"]) {
-                        if (g == game_name) return true;
-                    }
-                }
+public:
+    explicit Database(const DbOptions& opts = DbOptions()) {
+        async_durability = opts.durability == "async";
+        rating_min_votes = opts.rating_min_votes;
+        plays_lambda = std::log(2.0) / (opts.plays_half_life_hours * 3600);
+        stats_flush_interval = std::chrono::seconds(opts.stats_flush_interval_s);
+        std::chrono::microseconds window(opts.group_commit_window_us);
+        if (async_durability) window = std::chrono::milliseconds(opts.flush_interval_ms);
+        if (opts.engine == "sqlite") {
+            auto sqlite = std::make_unique<SqliteStorage>(opts.sqlite_path, window, opts.group_commit_max_records,
+                                                         async_durability);
+            if (!sqlite->ok()) {
+                std::cerr << "Error: cannot open SQLite database " << opts.sqlite_path << std::endl;
+                exit(1);
             }
+            storage = std::move(sqlite);
+        } else {
+            storage = std::make_unique<JsonStorage>(opts.json_path, opts.snapshot_format, window,
+                                                    opts.group_commit_max_records, async_durability,
+                                                    opts.read_only);
         }
-        return false;
+        load();
+        if (opts.read_only) return;
+        compact_requested = storage->needs_checkpoint();
+        std::cout << "[DB] Storage engine: " << storage->name() << ", durability: "
+                  << (async_durability ? "async" : "sync") << std::endl;
+        compactor = std::thread(&Database::compact_loop, this);
     }
 
-    bool add_comment(const std::string& game_name, const std::string& user, int score, const std::string& content) {
-        std::lock_guard<std::mutex> lock(db_mutex);
-        for (auto& g : db_data["games"]) {
-            if (g["name"] == game_name) {
-                if (!g.contains("comments")) g["comments"] = json::array();
+    ~Database() {
+        {
+            std::lock_guard<std::mutex> lock(commit_mutex);
+            stopping = true;
+        }
+        compact_cv.notify_one();
+        if (compactor.joinable()) compactor.join();
+    }
 
-                for (const auto& c : g["comments"]) {
-                    if (c["user"] == user) return false;
-                }
+    std::string get_game_owner(const std::string& game_name) {
+        std::shared_lock<FairSharedMutex> lock(games_mutex);
+        GameRecord* g = find_game(game_name);
+        return g ? str(g->dev) : "";
+    }
+
+    int get_game_max_players(const std::string& game_name) {
+        std::shared_lock<FairSharedMutex> lock(games_mutex);
+        GameRecord* g = find_game(game_name);
+        return g ? g->max_players : 2;
+    }
+
+    void increment_download_count(const std::string& game_name) {
+        uint64_t lsn = 0;
+        {
+            std::unique_lock<FairSharedMutex> lock(games_mutex);
+            if (!find_game(game_name)) return;
+            lsn = commit({{"op", "increment_downloads"}, {"game", game_name}});
+        }
+        make_durable(lsn);
+    }
+
+    void record_play_history(const std::string& username, const std::string& game_name) {
+        record_play_history(std::vector<std::string>{username}, game_name);
+    }
 
-                json comment = {
-                    {"user", user},
-                    {"score", score},
-                    {"content", content}
-                };
-                g["comments"].push_back(comment);
-                save();
-                return true;
+    // Records a finished match for all its players with a single durability wait.
+    void record_play_history(const std::vector<std::string>& usernames, const std::string& game_name) {
+        uint64_t lsn = 0;
+        if (usernames.empty()) return;
+        uint32_t game = StringInterner::NONE;
+        {
+            // The record carries the updated trend so replay needs no clock.
+            std::unique_lock<FairSharedMutex> lock(games_mutex);
+            GameRecord* g = find_game(game_name);
+            if (g) {
+                game = g->name;
+                analytics.record(game, GameMetric::MATCHES_FINISHED);
+                double plays = std::log((double)usernames.size()) + plays_lambda * now_seconds();
+                lsn = commit({
+                    {"op", "record_plays"},
+                    {"game", game_name},
+                    {"plays", usernames.size()},
+                    {"trend", log_add(g->play_trend, plays)}
+                });
             }
         }
-        return false;
+        {
+            // Co-play counts only cover games in the catalog, so the games shard
+            // must not change under a record_play.
+            std::shared_lock<FairSharedMutex> games_lock(games_mutex);
+            std::unique_lock<FairSharedMutex> lock(users_mutex);
+            for (const auto& username : usernames) {
+                UserRecord* u = find_user(username);
+                if (!u || in_set(u->play_history, game_name)) continue;
+                lsn = commit({{"op", "record_play"}, {"user", username}, {"game", game_name}});
+                if (game != StringInterner::NONE) analytics.record(game, GameMetric::PLAYERS);
+            }
+        }
+        if (lsn) make_durable(lsn);
+    }
+
+    void record_match_started(const std::string& game_name) {
+        uint32_t game = strings.find(game_name);
+        if (game != StringInterner::NONE) analytics.record(game, GameMetric::MATCHES_STARTED);
+    }
+
+    // Hourly and daily activity of the game; null if it does not exist.
+    json game_stats(const std::string& game_name) {
+        std::shared_lock<FairSharedMutex> lock(games_mutex);
+        GameRecord* g = find_game(game_name);
+        if (!g) return nullptr;
+        json j = analytics.query(g->name);
+        j["game"] = game_name;
+        j["lifetime_downloads"] = g->downloaded_by.cardinality();
+        return j;
+    }
+
+    bool has_played(const std::string& username, const std::string& game_name) {
+        std::shared_lock<FairSharedMutex> lock(users_mutex);
+        UserRecord* u = find_user(username);
+        return u && in_set(u->play_history, game_name);
+    }
+
+    bool add_comment(const std::string& game_name, const std::string& user, int score, const std::string& content) {
+        uint64_t lsn;
+        {
+            std::unique_lock<FairSharedMutex> lock(games_mutex);
+            GameRecord* g = find_game(game_name);
+            if (!g || !RatingAggregate::valid(score) || in_set(g->commenters, user)) return false;
+
+            lsn = commit({
+                {"op", "add_comment"},
+                {"game", game_name},
+                {"user", user},
+                {"score", score},
+                {"content", content}
+            });
+            analytics.record(g->name, GameMetric::RATINGS);
+        }
+        make_durable(lsn);
+        return true;
     }
 
     void record_download(const std::string& game_name, const std::string& username) {
-        std::lock_guard<std::mutex> lock(db_mutex);
-        for (auto& g : db_data["games"]) {
-            if (g["name"] == game_name) {
-                if (!g.contains("downloaded_by")) {
-                    g["downloaded_by"] = json::array();
-                }
-                
-                bool already_downloaded = false;
-                for (const auto& user : g["downloaded_by"]) {
-                    if (user == username) {
-                        already_downloaded = true;
-                        break;
-                    }
-                }
-                
-                if (!already_downloaded) {
-                    g["downloaded_by"].push_back(username);
-                    save();
-                }
-                return;
-            }
+        uint64_t lsn;
+        {
+            std::unique_lock<FairSharedMutex> lock(games_mutex);
+            GameRecord* g = find_game(game_name);
+            if (!g) return;
+            analytics.record(g->name, GameMetric::DOWNLOADS);
+            if (in_set(g->downloaded_by, username)) return;
+            lsn = commit({{"op", "record_download"}, {"game", game_name}, {"user", username}});
         }
+        make_durable(lsn);
+    }
+
+    // The developer's games as catalog entries plus recent activity totals.
+    json list_dev_games(const std::string& dev_name) {
+        std::shared_lock<FairSharedMutex> lock(games_mutex);
+        json list = json::array();
+        auto it = dev_games.find(strings.find(dev_name));
+        if (it == dev_games.end()) return list;
+        it->second.for_each([&](uint32_t game) {
+            json entry = listing_json(games[game_index.at(game)]);
+            entry["activity"] = analytics.totals(game);
+            list.push_back(entry);
+        });
+        return list;
     }
 
     json get_games() {
-        std::lock_guard<std::mutex> lock(db_mutex);
+        std::shared_lock<FairSharedMutex> lock(games_mutex);
+        return games_json();
+    }
+
+    // One page of a game's comments; null if the game does not exist.
+    json get_comments(const std::string& game_name, CommentOrder order, size_t offset, size_t limit) {
+        std::shared_lock<FairSharedMutex> lock(games_mutex);
+        GameRecord* g = find_game(game_name);
+        if (!g) return nullptr;
+
+        json page = json::array();
+        g->comments.page(order, offset, limit, [&](const Comment& c) { page.push_back(comment_json(c)); });
+
+        json res;
+        res["total"] = g->comments.size();
+        res["offset"] = offset;
+        res["comments"] = page;
+        return res;
+    }
+
+    // Catalog entries matching `query`, best match first.
+    json search_games(const std::string& query, size_t limit) {
+        std::shared_lock<FairSharedMutex> lock(games_mutex);
         json list = json::array();
-        for (const auto& g : db_data["games"]) {
-            json item = g;
-            
-            if (g.contains("comments")) {
-                item["avg_rating"] = calculate_rating(g["comments"]);
-                item["comment_count"] = g["comments"].size();
-            } else {
-                item["avg_rating"] = 0.0;
-                item["comment_count"] = 0;
-            }
+        for (uint32_t id : search_index.search(query, limit)) {
+            auto it = game_index.find(id);
+            if (it != game_index.end()) list.push_back(listing_json(games[it->second]));
+        }
+        return list;
+    }
 
-            if (g.contains("downloaded_by")) {
-                item["downloads"] = g["downloaded_by"].size();
-            } else {
-                item["downloads"] = 0;
-            }
-            
-            item.erase("downloaded_by");
+    // Games `username` has not played, ranked by how many co-players they share
+    // with the games the user has; topped up from the most downloaded games when
+    // the history says too little.
+    json recommend(const std::string& username, size_t limit) {
+        std::shared_lock<FairSharedMutex> games_lock(games_mutex);
+        std::shared_lock<FairSharedMutex> users_lock(users_mutex);
+        json list = json::array();
+        UserRecord* u = find_user(username);
+        if (!u) return list;
+
+        std::unordered_map<uint32_t, uint64_t> scores;
+        u->play_history.for_each([&](uint32_t played) {
+            coplay.neighbors(played, [&](uint32_t game, uint32_t count) {
+                if (!u->play_history.contains(game) && game_index.count(game)) scores[game] += count;
+            });
+        });
+
+        std::vector<std::pair<uint64_t, uint32_t>> ranked;
+        for (auto& [game, score] : scores) ranked.push_back({score, game});
+        size_t n = std::min(limit, ranked.size());
+        std::partial_sort(ranked.begin(), ranked.begin() + n, ranked.end(), [](const auto& a, const auto& b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        });
+        for (size_t i = 0; i < n; i++) {
+            json entry = listing_json(games[game_index.at(ranked[i].second)]);
+            entry["co_players"] = ranked[i].first;
+            list.push_back(entry);
+        }
 
-            list.push_back(item);
+        if (list.size() < limit) {
+            top_downloads.visit([&](uint32_t game, double) {
+                if (!u->play_history.contains(game) && !scores.count(game)) {
+                    list.push_back(listing_json(games[game_index.at(game)]));
+                }
+                return list.size() < limit;
+            });
         }
         return list;
     }
 
+    // Games most often played by players of `game_name`; null if no such game.
+    json also_played(const std::string& game_name, size_t limit) {
+        std::shared_lock<FairSharedMutex> games_lock(games_mutex);
+        std::shared_lock<FairSharedMutex> users_lock(users_mutex);
+        GameRecord* g = find_game(game_name);
+        if (!g) return nullptr;
+
+        json list = json::array();
+        coplay.neighbors(g->name, [&](uint32_t game, uint32_t count) {
+            auto it = game_index.find(game);
+            if (list.size() >= limit || it == game_index.end()) return;
+            json entry = listing_json(games[it->second]);
+            entry["co_players"] = count;
+            list.push_back(entry);
+        });
+        return list;
+    }
+
+    // Best `limit` games by "downloads" (unique downloaders), "rating" (average,
+    // among games with enough ratings) or "plays" (time-decayed match players);
+    // null for any other ordering.
+    json top_games(const std::string& by, size_t limit) {
+        const Ranking* ranking = by == "downloads" ? &top_downloads
+                               : by == "rating"    ? &top_rated
+                               : by == "plays"     ? &top_played
+                               : nullptr;
+        if (!ranking) return nullptr;
+
+        std::shared_lock<FairSharedMutex> lock(games_mutex);
+        double now = plays_lambda * now_seconds();
+        json list = json::array();
+        ranking->top(limit, [&](uint32_t id, double score) {
+            json entry = listing_json(games[game_index.at(id)]);
+            if (ranking == &top_played) entry["recent_plays"] = std::exp(score - now);
+            list.push_back(entry);
+        });
+        return list;
+    }
+
+    // The complete list_games response, serialized once per catalog version.
+    std::shared_ptr<const std::string> get_catalog_response() {
+        std::shared_lock<FairSharedMutex> lock(games_mutex);
+        {
+            std::lock_guard<std::mutex> cache_lock(catalog_mutex);
+            if (catalog && catalog_built_version == catalog_version) return catalog;
+        }
+
+        json res = {{"status", "ok"}, {"data", games_json()}};
+        auto built = std::make_shared<const std::string>(res.dump());
+
+        std::lock_guard<std::mutex> cache_lock(catalog_mutex);
+        catalog = built;
+        catalog_built_version = catalog_version;
+        return built;
+    }
+
     bool register_user(const std::string& username, const std::string& password, const std::string& role) {
-        std::lock_guard<std::mutex> lock(db_mutex);
-        for (const auto& u : db_data["users"]) {
-            if (u["username"] == username) return false; 
-        }
-        json new_user = {
-            {"username", username},
-            {"password", password},
-            {"role", role} 
-        };
-        db_data["users"].push_back(new_user);
-        save();
+        uint64_t lsn;
+        {
+            std::unique_lock<FairSharedMutex> lock(users_mutex);
+            if (find_user(username)) return false;
+
+            lsn = commit({
+                {"op", "register_user"},
+                {"username", username},
+                {"password", password},
+                {"role", role}
+            });
+        }
+        make_durable(lsn);
         return true;
     }
 
     bool login_user(const std::string& username, const std::string& password, std::string& out_role) {
-        std::lock_guard<std::mutex> lock(db_mutex);
-        for (const auto& u : db_data["users"]) {
-            if (u["username"] == username && u["password"] == password) {
-                out_role = u["role"];
-                return true;
-            }
-        }
-        return false;
+        std::shared_lock<FairSharedMutex> lock(users_mutex);
+        UserRecord* u = find_user(username);
+        if (!u || u->password != password) return false;
+        out_role = str(u->role);
+        return true;
     }
 
-    void upsert_game(const std::string& dev_name, const std::string& game_name, 
-                     const std::string& desc, const std::string& filename, 
-                     const std::string& version, 
+    void upsert_game(const std::string& dev_name, const std::string& game_name,
+                     const std::string& desc, const std::string& filename,
+                     const std::string& version,
                      const std::string& type, int max_players) {
-        
-        std::lock_guard<std::mutex> lock(db_mutex);
-        bool found = false;
-        
-        for (auto& g : db_data["games"]) {
-            if (g["name"] == game_name && g["dev"] == dev_name) {
-                g["description"] = desc;
-                g["filename"] = filename;
-                g["version"] = version;
-                g["game_type"] = type;
-                g["max_players"] = max_players;
-                found = true;
-                break;
-            }
-        }
-        
-        if (!found) {
-            json new_game = {
-                {"name", game_name},
+
+        uint64_t lsn;
+        {
+            std::unique_lock<FairSharedMutex> lock(games_mutex);
+            lsn = commit({
+                {"op", "upsert_game"},
                 {"dev", dev_name},
+                {"name", game_name},
                 {"description", desc},
                 {"filename", filename},
                 {"version", version},
                 {"game_type", type},
-                {"max_players", max_players},
-                {"downloaded_by", json::array()}
-            };
-            db_data["games"].push_back(new_game);
+                {"max_players", max_players}
+            });
         }
-        save();
+        make_durable(lsn);
     }
 
     std::string delete_game(const std::string& dev_name, const std::string& game_name) {
-        std::lock_guard<std::mutex> lock(db_mutex);
-        auto& games = db_data["games"];
-        for (auto it = games.begin(); it != games.end(); ++it) {
-            if ((*it)["name"] == game_name && (*it)["dev"] == dev_name) {
-                std::string filename = (*it)["filename"];
-                games.erase(it);
-                save();
-                return filename;
+        std::string filename;
+        uint64_t lsn = 0;
+        {
+            // Deleting also drops the game from the co-play index (users shard).
+            std::unique_lock<FairSharedMutex> games_lock(games_mutex);
+            std::unique_lock<FairSharedMutex> users_lock(users_mutex);
+            GameRecord* g = find_game(game_name);
+            if (g && str(g->dev) == dev_name) {
+                filename = g->filename;
+                lsn = commit({{"op", "delete_game"}, {"dev", dev_name}, {"name", game_name}});
             }
         }
-        return "";
+        if (lsn) make_durable(lsn);
+        return filename;
     }
-    
-    std::string get_game_filename(const std::string& game_name) {
-        std::lock_guard<std::mutex> lock(db_mutex);
-        for (const auto& g : db_data["games"]) {
-            if (g["name"] == game_name) {
-                return g["filename"];
-            }
+
+    json stats() {
+        json s;
+        s["storage"] = storage->stats();
+        s["durability"] = async_durability ? "async" : "sync";
+        std::shared_lock<FairSharedMutex> games_lock(games_mutex);
+        std::shared_lock<FairSharedMutex> users_lock(users_mutex);
+        s["users"] = users.size();
+        s["games"] = games.size();
+        s["interned_strings"] = strings.size();
+        s["search_terms"] = search_index.term_count();
+        s["coplay_pairs"] = coplay.pairs();
+        return s;
+    }
+
+    // Blocks until every mutation accepted so far, and the current analytics,
+    // are on disk.
+    void flush() {
+        flush_stats();
+        uint64_t lsn;
+        {
+            std::lock_guard<std::mutex> lock(commit_mutex);
+            lsn = last_lsn;
+        }
+        if (!storage->wait_durable(lsn)) {
+            std::cerr << "Error: mutations up to LSN " << lsn << " may not be on disk." << std::endl;
         }
-        return "";
     }
-};
\ No newline at end of file
+
+    // Full database.json-shaped document, e.g. for migrating between engines.
+    json export_snapshot() {
+        std::string image;
+        {
+            std::shared_lock<FairSharedMutex> games_lock(games_mutex);
+            std::shared_lock<FairSharedMutex> users_lock(users_mutex);
+            std::lock_guard<std::mutex> lock(commit_mutex);
+            image = encode_snapshot();
+        }
+        SnapshotReader reader;
+        reader.open(image.data(), image.size());
+        return reader.to_json();
+    }
+
+    std::string get_game_filename(const std::string& game_name) {
+        std::shared_lock<FairSharedMutex> lock(games_mutex);
+        GameRecord* g = find_game(game_name);
+        return g ? g->filename : "";
+    }
+};
@@ -0,0 +1,160 @@
+#pragma once
+#include "../json.hpp"
+#include "file_checksums.hpp"
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+    // From the file's .crc sidecar; null if it has none for this version.
+    std::shared_ptr<const FileChecksums> checksums;
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (data) munmap((void*)data, size);
+    }
+
+    static std::shared_ptr<const MappedFile> open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return nullptr;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return nullptr;
+        }
+
+        auto file = std::make_shared<MappedFile>();
+        file->size = st.st_size;
+        if (file->size > 0) {
+            void* p = mmap(nullptr, file->size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                return nullptr;
+            }
+            madvise(p, file->size, MADV_WILLNEED);
+            file->data = (const char*)p;
+        }
+        ::close(fd);
+        file->checksums = FileChecksums::load(path, st);
+        return file;
+    }
+
+    // Per-chunk checksums for multi-stream downloads, combined from the stored
+    // block checksums and memoized per chunk size. `chunk_size` must be a
+    // multiple of FileChecksums::BLOCK.
+    std::vector<uint32_t> chunk_crcs(size_t chunk_size) const {
+        std::lock_guard<std::mutex> lock(crc_mutex);
+        auto it = chunk_crc_memo.find(chunk_size);
+        if (it != chunk_crc_memo.end()) return it->second;
+
+        std::vector<uint32_t> crcs = checksums->chunks(chunk_size);
+        chunk_crc_memo[chunk_size] = crcs;
+        return crcs;
+    }
+
+private:
+    mutable std::mutex crc_mutex;
+    mutable std::map<size_t, std::vector<uint32_t>> chunk_crc_memo;
+};
+
+// Size-bounded LRU of mmapped game files shared by every download session.
+// Evicted or invalidated entries stay mapped until the last session drops them.
+// Files are mapped outside the lock, so a miss only caches its mapping if no
+// invalidate() ran meanwhile; otherwise it may be the file being replaced.
+class FileCache {
+private:
+    struct Entry {
+        std::shared_ptr<const MappedFile> file;
+        std::list<std::string>::iterator lru_pos;
+    };
+
+    size_t capacity_bytes;
+    size_t resident_bytes = 0;
+    std::list<std::string> lru;
+    std::unordered_map<std::string, Entry> entries;
+    uint64_t generation = 0;  // bumped by every invalidate()
+    std::mutex cache_mutex;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> evictions{0};
+
+    void drop(std::unordered_map<std::string, Entry>::iterator it) {
+        resident_bytes -= it->second.file->size;
+        lru.erase(it->second.lru_pos);
+        entries.erase(it);
+    }
+
+public:
+    explicit FileCache(size_t capacity) : capacity_bytes(capacity) {}
+
+    std::shared_ptr<const MappedFile> acquire(const std::string& path) {
+        uint64_t seen;
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            auto it = entries.find(path);
+            if (it != entries.end()) {
+                lru.splice(lru.begin(), lru, it->second.lru_pos);
+                hits++;
+                return it->second.file;
+            }
+            seen = generation;
+        }
+
+        misses++;
+        auto file = MappedFile::open(path);
+        if (!file || file->size > capacity_bytes) return file;
+
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        if (generation != seen) return file;
+        auto it = entries.find(path);
+        if (it != entries.end()) return it->second.file;
+
+        lru.push_front(path);
+        entries[path] = {file, lru.begin()};
+        resident_bytes += file->size;
+
+        while (resident_bytes > capacity_bytes && !lru.empty()) {
+            drop(entries.find(lru.back()));
+            evictions++;
+        }
+        return file;
+    }
+
+    void invalidate(const std::string& path) {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        generation++;
+        auto it = entries.find(path);
+        if (it != entries.end()) drop(it);
+    }
+
+    json stats() {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        uint64_t h = hits, m = misses;
+        json s;
+        s["hits"] = h;
+        s["misses"] = m;
+        s["hit_rate"] = (h + m) ? (double)h / (h + m) : 0.0;
+        s["evictions"] = evictions.load();
+        s["entries"] = entries.size();
+        s["resident_bytes"] = resident_bytes;
+        s["capacity_bytes"] = capacity_bytes;
+        return s;
+    }
+};
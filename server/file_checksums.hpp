@@ -0,0 +1,136 @@
+#pragma once
+#include "../checksum.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+// CRC32C of every BLOCK bytes of a served file. Whole-file and per-chunk
+// checksums are combined from these, so a file is read for checksumming once,
+// when it is written, and never on the download path. Kept next to the file
+// as "<file>.crc" together with the size and mtime it describes; a stale or
+// missing one is simply not used.
+struct FileChecksums {
+    static constexpr size_t BLOCK = 256 * 1024;
+
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    uint32_t whole = 0;
+    std::vector<uint32_t> blocks;
+
+    static int64_t mtime_of(const struct stat& st) {
+#ifdef __APPLE__
+        return (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+        return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    }
+
+    // Feeds the file's next bytes; the last block may be partial.
+    void update(const void* data, size_t len) {
+        const char* p = (const char*)data;
+        while (len > 0) {
+            size_t used = size % BLOCK;
+            if (used == 0) blocks.push_back(0);
+            size_t n = std::min(len, BLOCK - used);
+            blocks.back() = crc32c_update(blocks.back(), p, n);
+            p += n;
+            len -= n;
+            size += n;
+        }
+    }
+
+    // Completes `whole` once every byte has been fed.
+    void finish() {
+        whole = chunks(blocks.size() * BLOCK).front();
+    }
+
+    // Records which version of the file these checksums describe.
+    void stamp(const struct stat& st) { mtime_ns = mtime_of(st); }
+
+    bool describes(const struct stat& st) const {
+        return (uint64_t)st.st_size == size && mtime_of(st) == mtime_ns;
+    }
+
+    // Checksums of consecutive `chunk_size` ranges; chunk_size must be a
+    // multiple of BLOCK.
+    std::vector<uint32_t> chunks(size_t chunk_size) const {
+        if (blocks.empty()) return {0};
+        std::vector<uint32_t> crcs;
+        size_t per_chunk = std::max<size_t>(1, chunk_size / BLOCK);
+        for (size_t first = 0; first < blocks.size(); first += per_chunk) {
+            uint32_t crc = 0;
+            size_t last = std::min(blocks.size(), first + per_chunk);
+            for (size_t i = first; i < last; i++) {
+                crc = crc32c_combine(crc, blocks[i], std::min<uint64_t>(BLOCK, size - i * BLOCK));
+            }
+            crcs.push_back(crc);
+        }
+        return crcs;
+    }
+
+    // Reads `file` through once; it should not change meanwhile.
+    static bool compute(const std::string& file, FileChecksums& out) {
+        std::ifstream in(file, std::ios::binary);
+        struct stat st;
+        if (!in.is_open() || stat(file.c_str(), &st) != 0) return false;
+
+        out = FileChecksums();
+        std::vector<char> buffer(BLOCK);
+        while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0) {
+            out.update(buffer.data(), in.gcount());
+        }
+        out.finish();
+        out.stamp(st);
+        return out.describes(st);
+    }
+
+    // Writes "<file>.crc" through a temporary, so readers see old or new.
+    bool save(const std::string& file) const {
+        std::string path = file + ".crc", tmp = path + ".part";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            uint32_t block = BLOCK, count = blocks.size();
+            out.write("CRC1", 4);
+            out.write((const char*)&block, sizeof(block));
+            out.write((const char*)&size, sizeof(size));
+            out.write((const char*)&mtime_ns, sizeof(mtime_ns));
+            out.write((const char*)&whole, sizeof(whole));
+            out.write((const char*)&count, sizeof(count));
+            out.write((const char*)blocks.data(), count * sizeof(uint32_t));
+            if (!out.good()) {
+                remove(tmp.c_str());
+                return false;
+            }
+        }
+        return rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    // The saved checksums of `file`, or null unless they describe `st`.
+    static std::shared_ptr<const FileChecksums> load(const std::string& file, const struct stat& st) {
+        std::ifstream in(file + ".crc", std::ios::binary);
+        if (!in.is_open()) return nullptr;
+
+        auto sums = std::make_shared<FileChecksums>();
+        char magic[4];
+        uint32_t block = 0, count = 0;
+        in.read(magic, 4);
+        in.read((char*)&block, sizeof(block));
+        in.read((char*)&sums->size, sizeof(sums->size));
+        in.read((char*)&sums->mtime_ns, sizeof(sums->mtime_ns));
+        in.read((char*)&sums->whole, sizeof(sums->whole));
+        in.read((char*)&count, sizeof(count));
+        if (!in.good() || std::string(magic, 4) != "CRC1" || block != BLOCK || !sums->describes(st) ||
+            count != (sums->size + BLOCK - 1) / BLOCK) {
+            return nullptr;
+        }
+        sums->blocks.resize(count);
+        in.read((char*)sums->blocks.data(), count * sizeof(uint32_t));
+        if (!in.good()) return nullptr;
+        return sums;
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include "rw_lock.hpp"
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Maps each distinct string to a dense 32-bit id. Ids are never reused and the
+// backing strings never move, so ids and the references returned by str() stay
+// valid for the interner's lifetime. Safe to use from several threads.
+class StringInterner {
+private:
+    std::deque<std::string> strings;
+    std::unordered_map<std::string_view, uint32_t> ids;
+    mutable FairSharedMutex intern_mutex;
+
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    uint32_t intern(std::string_view s) {
+        {
+            std::shared_lock<FairSharedMutex> lock(intern_mutex);
+            auto it = ids.find(s);
+            if (it != ids.end()) return it->second;
+        }
+
+        std::unique_lock<FairSharedMutex> lock(intern_mutex);
+        auto it = ids.find(s);
+        if (it != ids.end()) return it->second;
+
+        strings.emplace_back(s);
+        uint32_t id = (uint32_t)(strings.size() - 1);
+        ids.emplace(strings.back(), id);
+        return id;
+    }
+
+    // Lookup without inserting; NONE if the string was never interned.
+    uint32_t find(std::string_view s) const {
+        std::shared_lock<FairSharedMutex> lock(intern_mutex);
+        auto it = ids.find(s);
+        return it == ids.end() ? NONE : it->second;
+    }
+
+    // The string behind `id`; empty for NONE or any id never handed out.
+    const std::string& str(uint32_t id) const {
+        static const std::string empty;
+        std::shared_lock<FairSharedMutex> lock(intern_mutex);
+        return id < strings.size() ? strings[id] : empty;
+    }
+
+    size_t size() const {
+        std::shared_lock<FairSharedMutex> lock(intern_mutex);
+        return strings.size();
+    }
+};
+
+// Process-wide interner, shared by the Database, the RoomManager and the
+// lobby's client table so they all agree on the ids. Besides user and game
+// names it holds every other interned record field (roles, versions, game
+// types), and a binary snapshot writes out all of it, in id order.
+inline StringInterner& name_interner() {
+    static StringInterner interner;
+    return interner;
+}
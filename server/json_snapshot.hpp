@@ -0,0 +1,215 @@
+#pragma once
+#include "../json.hpp"
+#include "analytics.hpp"
+#include "interner.hpp"
+#include "records.hpp"
+#include <fstream>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+// Streams a database.json document into typed records through json.hpp's SAX
+// interface, so no DOM of the file is ever built: each user or game is filled
+// in as its fields arrive and moved out when its object closes. Fields and
+// sections it does not know are skipped, and missing fields keep the defaults
+// the DOM loader used.
+class JsonSnapshotLoader {
+private:
+    enum Frame {
+        ROOT, USERS, USER, HISTORY, GAMES, GAME, COMMENTS, COMMENT, DOWNLOADERS,
+        STATS, STAT_LIST, STAT_ROW, SKIP
+    };
+
+    std::ifstream in;
+    StringInterner* strings = nullptr;
+    std::vector<UserRecord>* users = nullptr;
+    std::vector<GameRecord>* games = nullptr;
+    GameAnalytics* analytics = nullptr;
+    std::vector<Frame> stack;
+    std::string current_key;
+    uint32_t empty = 0;
+    UserRecord user;
+    GameRecord game;
+    Comment comment;
+    // The game's analytics buckets, kept until its name is known.
+    std::vector<std::pair<StatBucket, bool>> stats;
+    std::vector<uint32_t> stat_row;
+    bool stats_daily = false;
+    uint64_t last_lsn = 0;
+    bool failed = false;
+
+    Frame top() const { return stack.empty() ? SKIP : stack.back(); }
+
+    bool number(double v) {
+        Frame f = top();
+        if (f == ROOT && current_key == "lsn") last_lsn = (uint64_t)v;
+        else if (f == GAME && current_key == "max_players") game.max_players = (int)v;
+        else if (f == GAME && current_key == "downloads") game.downloads = (int)v;
+        else if (f == GAME && current_key == "play_trend") game.play_trend = v;
+        else if (f == COMMENT && current_key == "score") comment.score = (int)v;
+        else if (f == STAT_ROW) stat_row.push_back((uint32_t)v);
+        return true;
+    }
+
+public:
+    using number_integer_t = json::number_integer_t;
+    using number_unsigned_t = json::number_unsigned_t;
+    using number_float_t = json::number_float_t;
+    using string_t = json::string_t;
+    using binary_t = json::binary_t;
+
+    // False if the file does not exist.
+    bool open(const std::string& path) {
+        in.open(path, std::ios::binary);
+        return in.good();
+    }
+
+    // Appends the file's users and games and restores their analytics. On
+    // malformed input the vectors are cut back to their original length and
+    // false is returned.
+    bool load(StringInterner& s, std::vector<UserRecord>& out_users, std::vector<GameRecord>& out_games,
+              GameAnalytics& out_stats) {
+        strings = &s;
+        users = &out_users;
+        games = &out_games;
+        analytics = &out_stats;
+        empty = s.intern("");
+        size_t user_base = out_users.size(), game_base = out_games.size();
+        bool ok = json::sax_parse(in, this) && !failed;
+        if (!ok) {
+            for (size_t i = game_base; i < out_games.size(); i++) out_stats.clear(out_games[i].name);
+            out_users.resize(user_base);
+            out_games.resize(game_base);
+            last_lsn = 0;
+            failed = true;
+        }
+        return ok;
+    }
+
+    uint64_t lsn() const { return last_lsn; }
+    bool ok() const { return !failed; }
+
+    bool null() { return true; }
+    bool boolean(bool) { return true; }
+    bool number_integer(number_integer_t v) { return number((double)v); }
+    bool number_float(number_float_t v, const string_t&) { return number(v); }
+    bool binary(binary_t&) { return true; }
+
+    bool number_unsigned(number_unsigned_t v) {
+        // LSNs can exceed a double's exact range.
+        if (top() == ROOT && current_key == "lsn") {
+            last_lsn = v;
+            return true;
+        }
+        return number((double)v);
+    }
+
+    bool string(string_t& v) {
+        switch (top()) {
+        case USER:
+            if (current_key == "username") user.username = strings->intern(v);
+            else if (current_key == "role") user.role = strings->intern(v);
+            else if (current_key == "password") user.password = std::move(v);
+            break;
+        case HISTORY:
+            user.play_history.add(strings->intern(v));
+            break;
+        case GAME:
+            if (current_key == "name") game.name = strings->intern(v);
+            else if (current_key == "dev") game.dev = strings->intern(v);
+            else if (current_key == "version") game.version = strings->intern(v);
+            else if (current_key == "game_type") game.game_type = strings->intern(v);
+            else if (current_key == "description") game.description = std::move(v);
+            else if (current_key == "filename") game.filename = std::move(v);
+            break;
+        case COMMENT:
+            if (current_key == "user") comment.user = strings->intern(v);
+            else if (current_key == "content") comment.content = std::move(v);
+            break;
+        case DOWNLOADERS:
+            game.downloaded_by.add(strings->intern(v));
+            break;
+        default:
+            break;
+        }
+        return true;
+    }
+
+    bool key(string_t& k) {
+        current_key = std::move(k);
+        return true;
+    }
+
+    bool start_object(std::size_t) {
+        Frame f = top();
+        if (stack.empty()) {
+            stack.push_back(ROOT);
+        } else if (f == USERS) {
+            user = UserRecord();
+            user.username = user.role = empty;
+            stack.push_back(USER);
+        } else if (f == GAMES) {
+            game = GameRecord();
+            game.name = game.dev = game.version = game.game_type = empty;
+            stats.clear();
+            stack.push_back(GAME);
+        } else if (f == COMMENTS) {
+            comment = {empty, 0, ""};
+            stack.push_back(COMMENT);
+        } else if (f == GAME && current_key == "stats") {
+            stack.push_back(STATS);
+        } else {
+            stack.push_back(SKIP);
+        }
+        return true;
+    }
+
+    bool end_object() {
+        Frame f = top();
+        stack.pop_back();
+        if (f == USER) {
+            users->push_back(std::move(user));
+        } else if (f == GAME) {
+            for (const auto& [bucket, daily] : stats) analytics->restore(game.name, bucket, daily);
+            games->push_back(std::move(game));
+        } else if (f == COMMENT) {
+            if (!RatingAggregate::valid(comment.score)) return true;
+            game.rating.add(comment.score);
+            game.commenters.add(comment.user);
+            game.comments.add(std::move(comment));
+        }
+        return true;
+    }
+
+    bool start_array(std::size_t) {
+        Frame f = top();
+        Frame next = SKIP;
+        if (f == ROOT && current_key == "users") next = USERS;
+        else if (f == ROOT && current_key == "games") next = GAMES;
+        else if (f == USER && current_key == "play_history") next = HISTORY;
+        else if (f == GAME && current_key == "comments") next = COMMENTS;
+        else if (f == GAME && current_key == "downloaded_by") next = DOWNLOADERS;
+        else if (f == STATS && (current_key == "hours" || current_key == "days")) next = STAT_LIST;
+        else if (f == STAT_LIST) next = STAT_ROW;
+        if (next == STAT_LIST) stats_daily = current_key == "days";
+        if (next == STAT_ROW) stat_row.clear();
+        stack.push_back(next);
+        return true;
+    }
+
+    bool end_array() {
+        if (top() == STAT_ROW && stat_row.size() == GAME_METRICS + 1) {
+            StatBucket b{stat_row[0], {}};
+            std::copy(stat_row.begin() + 1, stat_row.end(), b.counts);
+            stats.push_back({b, stats_daily});
+        }
+        stack.pop_back();
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) {
+        failed = true;
+        return false;
+    }
+};
@@ -1,6 +1,10 @@
 #include "../basic.hpp"
+#include "../codec.hpp"
 #include "db.hpp"
 #include "room.hpp"
+#include "file_cache.hpp"
+#include "transfer.hpp"
+#include "work_queue.hpp"
 
 #include <iostream>
 #include <vector>
@@ -13,8 +17,36 @@
 #include <thread>
 #include <chrono>
 #include <cstdio>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <dirent.h>
 
 #define SERVER_PORT 10988
+#define FILE_CACHE_CAPACITY (64 * 1024 * 1024)
+#define MAX_DOWNLOAD_STREAMS 8
+#define MIN_CHUNK_SIZE (256 * 1024)
+#define TRANSFER_GLOBAL_BPS (50.0 * 1024 * 1024)
+#define TRANSFER_USER_BPS (10.0 * 1024 * 1024)
+#define TRANSFER_REACTORS 2
+#define GROUP_COMMIT_WINDOW_US 2000
+#define GROUP_COMMIT_MAX_RECORDS 256
+#define DB_ENGINE "json"
+#define DB_SNAPSHOT_FORMAT "binary"
+// "sync" acknowledges a mutation once it is on disk; GAMESTORE_DB_DURABILITY=async
+// acknowledges after the in-memory apply and can lose the last flush interval.
+#define DB_DURABILITY "sync"
+#define DB_FLUSH_INTERVAL_MS 200
+#define COMMENTS_PAGE_DEFAULT 10
+#define COMMENTS_PAGE_MAX 50
+#define SEARCH_RESULTS_DEFAULT 20
+#define SEARCH_RESULTS_MAX 100
+#define TOP_GAMES_DEFAULT 10
+#define TOP_GAMES_MAX 50
+#define TOP_RATING_MIN_VOTES 3
+#define TOP_PLAYS_HALF_LIFE_HOURS 72
+#define RECOMMEND_DEFAULT 5
+#define RECOMMEND_MAX 32
+#define GAME_STATS_FLUSH_INTERVAL_S 60
 
 enum class ClientState {
     CONNECTED,
@@ -25,23 +57,58 @@ enum class ClientState {
 struct ClientInfo {
     int sockfd;
     ClientState state;
-    std::string username;
+    uint32_t user_id;  // interned username, NONE while not logged in
     std::string role;
     int room_id;
 
-    ClientInfo() : sockfd(-1), state(ClientState::CONNECTED), room_id(-1) {}
+    ClientInfo() : sockfd(-1), state(ClientState::CONNECTED), user_id(StringInterner::NONE), room_id(-1) {}
+
+    const std::string& username() const {
+        static const std::string guest;
+        return user_id == StringInterner::NONE ? guest : name_interner().str(user_id);
+    }
 };
 
-Database db;
+DbOptions make_db_options() {
+    DbOptions opts;
+    const char* engine = getenv("GAMESTORE_DB_ENGINE");
+    opts.engine = engine ? engine : DB_ENGINE;
+    const char* snapshot = getenv("GAMESTORE_DB_SNAPSHOT");
+    opts.snapshot_format = snapshot ? snapshot : DB_SNAPSHOT_FORMAT;
+    const char* durability = getenv("GAMESTORE_DB_DURABILITY");
+    opts.durability = durability ? durability : DB_DURABILITY;
+    opts.flush_interval_ms = DB_FLUSH_INTERVAL_MS;
+    opts.rating_min_votes = TOP_RATING_MIN_VOTES;
+    opts.plays_half_life_hours = TOP_PLAYS_HALF_LIFE_HOURS;
+    opts.stats_flush_interval_s = GAME_STATS_FLUSH_INTERVAL_S;
+    opts.group_commit_window_us   = GROUP_COMMIT_WINDOW_US;
+    opts.group_commit_max_records = GROUP_COMMIT_MAX_RECORDS;
+    return opts;
+}
+
+Database db(make_db_options());
 RoomManager room_mgr;
+FileCache file_cache(FILE_CACHE_CAPACITY);
+WorkQueue artifact_jobs;
+// Held while swapping a raw game file or a compressed sidecar into place, so a
+// background build never publishes a sidecar of the file an upload replaced.
+std::mutex artifact_mutex;
+TransferScheduler transfer_sched(TRANSFER_GLOBAL_BPS, TRANSFER_USER_BPS);
+TransferPool transfers(transfer_sched, TRANSFER_REACTORS);
 std::map<int, ClientInfo> clients;
 fd_set master_fds;
 int fdmax;
 
+volatile sig_atomic_t stop_requested = 0;
+
 void handle_sigchld(int sig) {
     while (waitpid(-1, NULL, WNOHANG) > 0);
 }
 
+void handle_stop(int sig) {
+    stop_requested = 1;
+}
+
 void ensure_directory_exists(const std::string& path) {
     struct stat st = {0};
     if (stat(path.c_str(), &st) == -1) {
@@ -49,89 +116,138 @@ void ensure_directory_exists(const std::string& path) {
     }
 }
 
-void handle_file_upload_connection(int transfer_sockfd, std::string filepath, size_t filesize) {
-    struct sockaddr_in cli_addr;
-    socklen_t clilen = sizeof(cli_addr);
-
-    struct timeval tv;
-    tv.tv_sec  = 10;
-    tv.tv_usec = 0;
-    setsockopt(transfer_sockfd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+void set_socket_tos(int sockfd, int tos) {
+    setsockopt(sockfd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+}
 
-    int data_sock = accept(transfer_sockfd, (struct sockaddr*)&cli_addr, &clilen);
-    if (data_sock < 0) {
-        close(transfer_sockfd);
-        return;
+std::string artifact_path(const std::string& filepath, Encoding enc) {
+    switch (enc) {
+        case Encoding::GZIP: return filepath + ".gz";
+        case Encoding::ZSTD: return filepath + ".zst";
+        default:             return filepath;
     }
+}
 
-    std::ofstream outfile(filepath, std::ios::binary);
-    if (!outfile.is_open()) {
-        close(data_sock);
-        close(transfer_sockfd);
-        return;
+void remove_compressed_artifacts(const std::string& filepath) {
+    for (Encoding enc : {Encoding::GZIP, Encoding::ZSTD}) {
+        std::string path = artifact_path(filepath, enc);
+        file_cache.invalidate(path);
+        remove(path.c_str());
+        remove((path + ".crc").c_str());
     }
+}
+
+bool same_file(const struct stat& a, const struct stat& b) {
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size &&
+           a.st_mtime == b.st_mtime;
+}
 
-    size_t remaining = filesize;
-    char buffer[4096];
+// Runs on artifact_jobs. Gives up on the file as soon as an upload replaces
+// it; that upload has queued its own build.
+void build_compressed_artifacts(const std::string& filepath) {
+    struct stat source;
+    if (stat(filepath.c_str(), &source) != 0) return;
+    for (Encoding enc : supported_encodings()) {
+        std::string dst = artifact_path(filepath, enc);
+        std::string tmp = dst + ".part";
+        if (!compress_file(filepath, tmp, enc)) continue;
+
+        FileChecksums checksums;
+        if (get_file_size(tmp) >= (long)source.st_size || !FileChecksums::compute(tmp, checksums)) {
+            remove(tmp.c_str());
+            continue;
+        }
 
-    while (remaining > 0) {
-        size_t to_read = (remaining > sizeof(buffer)) ? sizeof(buffer) : remaining;
-        if (!recv_raw_data(data_sock, buffer, to_read)) break;
-        outfile.write(buffer, to_read);
-        remaining -= to_read;
+        std::lock_guard<std::mutex> lock(artifact_mutex);
+        struct stat now;
+        if (stat(filepath.c_str(), &now) != 0 || !same_file(source, now)) {
+            remove(tmp.c_str());
+            return;
+        }
+        checksums.save(dst);
+        rename(tmp.c_str(), dst.c_str());
+        file_cache.invalidate(dst);
     }
+}
 
-    outfile.close();
-    close(data_sock);
-    close(transfer_sockfd);
+bool has_extension(const std::string& name, std::initializer_list<const char*> exts) {
+    for (const char* ext : exts) {
+        size_t n = strlen(ext);
+        if (name.size() > n && name.compare(name.size() - n, n, ext) == 0) return true;
+    }
+    return false;
+}
 
-    std::cout << "[System] File saved: " << filepath << std::endl;
+// Checksums the file unless its .crc sidecar already describes it.
+void ensure_checksums(const std::string& filepath) {
+    struct stat st;
+    if (stat(filepath.c_str(), &st) != 0 || FileChecksums::load(filepath, st)) return;
+    FileChecksums checksums;
+    if (FileChecksums::compute(filepath, checksums)) checksums.save(filepath);
 }
 
-void handle_file_download_connection(int transfer_sockfd, std::string filepath) {
-    struct sockaddr_in cli_addr;
-    socklen_t clilen = sizeof(cli_addr);
+// Startup pass: checksums any served file that lacks them (files copied in by
+// hand, or written before checksums were stored) and queues missing sidecars.
+void prepare_compressed_artifacts(const std::string& dir) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) return;
 
-    struct timeval tv;
-    tv.tv_sec  = 10;
-    tv.tv_usec = 0;
-    setsockopt(transfer_sockfd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+    struct dirent* ent;
+    while ((ent = readdir(d)) != NULL) {
+        std::string name = ent->d_name;
+        if (name[0] == '.' || has_extension(name, {".part", ".crc"})) continue;
 
-    int data_sock = accept(transfer_sockfd, (struct sockaddr*)&cli_addr, &clilen);
-    if (data_sock < 0) {
-        std::cerr << "[Error] Download accept timeout." << std::endl;
-        close(transfer_sockfd);
-        return;
-    }
+        std::string filepath = dir + "/" + name;
+        ensure_checksums(filepath);
+        if (has_extension(name, {".gz", ".zst"})) continue;
 
-    std::ifstream infile(filepath, std::ios::binary);
-    if (!infile.is_open()) {
-        close(data_sock);
-        close(transfer_sockfd);
-        return;
+        for (Encoding enc : supported_encodings()) {
+            if (get_file_size(artifact_path(filepath, enc)) < 0) {
+                artifact_jobs.post([filepath] { build_compressed_artifacts(filepath); });
+                break;
+            }
+        }
     }
+    closedir(d);
+}
 
-    char buffer[4096];
-    while (infile.read(buffer, sizeof(buffer)) || infile.gcount() > 0) {
-        if (!send_raw_data(data_sock, buffer, infile.gcount())) break;
-        if (infile.eof()) break;
+// Maps the best artifact of `filepath` the client accepts, trying its
+// encodings in preference order and skipping any whose sidecar is missing
+// (too small to compress, or not built yet). Falls back to the raw file.
+std::shared_ptr<const MappedFile> negotiate_artifact(const json& req, const std::string& filepath, Encoding& enc) {
+    if (req.contains("accept_encoding") && req["accept_encoding"].is_array()) {
+        for (const auto& name : req["accept_encoding"]) {
+            if (!name.is_string() || !parse_encoding(name.get<std::string>(), enc) || !encoding_supported(enc)) continue;
+            if (enc == Encoding::IDENTITY) break;
+            if (auto blob = file_cache.acquire(artifact_path(filepath, enc))) return blob;
+        }
     }
-
-    infile.close();
-    close(data_sock);
-    close(transfer_sockfd);
-
-    std::cout << "[System] File sent: " << filepath << std::endl;
+    enc = Encoding::IDENTITY;
+    return file_cache.acquire(filepath);
 }
 
-long get_file_size_force(const std::string& path) {
-    struct stat stat_buf;
-    int rc = stat(path.c_str(), &stat_buf);
-    if (rc == 0) {
-        return stat_buf.st_size;
-    } else {
-        return -1;
+// Runs on a transfer reactor, so compression is left to artifact_jobs.
+// `old_filepath` is the game's previous file, which the cache may still hold
+// under another name. `checksums` were taken while the bytes streamed in.
+void finish_upload(const std::string& filepath, const std::string& old_filepath, bool ok,
+                   FileChecksums checksums) {
+    if (!ok) return;
+
+    // Rename instead of truncating in place so mmapped readers keep the old blob.
+    std::string part_path = filepath + ".part";
+    struct stat st;
+    if (stat(part_path.c_str(), &st) == 0) checksums.stamp(st);
+    {
+        std::lock_guard<std::mutex> lock(artifact_mutex);
+        remove_compressed_artifacts(filepath);
+        checksums.save(filepath);
+        rename(part_path.c_str(), filepath.c_str());
     }
+    file_cache.invalidate(filepath);
+    if (old_filepath != filepath) file_cache.invalidate(old_filepath);
+    artifact_jobs.post([filepath] { build_compressed_artifacts(filepath); });
+
+    std::cout << "[System] File saved: " << filepath << std::endl;
 }
 
 void handle_client_message(int sockfd) {
@@ -142,14 +258,14 @@ void handle_client_message(int sockfd) {
         ClientInfo& info = clients[sockfd];
         if (info.room_id != -1) {
             int rid = info.room_id;
-            int ret = room_mgr.leave_room(rid, info.username);
+            int ret = room_mgr.leave_room(rid, info.user_id);
 
             json notify;
             if (ret == 1) {
                 notify["action"] = "room_disbanded";
             } else {
                 notify["action"]   = "player_left";
-                notify["username"] = info.username;
+                notify["username"] = info.username();
                 notify["data"]     = room_mgr.get_room_info(rid);
             }
 
@@ -182,7 +298,7 @@ void handle_client_message(int sockfd) {
     ClientInfo& client = clients[sockfd];
 
     std::cout << "[Req] " 
-              << (client.username.empty() ? "Guest" : client.username)
+              << (client.username().empty() ? "Guest" : client.username())
               << ": " << action << std::endl;
 
     if (action == "register") {
@@ -199,8 +315,9 @@ void handle_client_message(int sockfd) {
         std::string target_user = req["username"];
         bool already_online = false;
 
+        uint32_t target_id = name_interner().find(target_user);
         for (const auto& [id, info] : clients) {
-            if (info.username == target_user &&
+            if (target_id != StringInterner::NONE && info.user_id == target_id &&
                 info.state != ClientState::CONNECTED) {
                 already_online = true;
                 break;
@@ -213,7 +330,7 @@ void handle_client_message(int sockfd) {
             std::string role;
             if (db.login_user(target_user, req["password"], role)) {
                 client.state    = ClientState::LOGGED_IN;
-                client.username = target_user;
+                client.user_id  = name_interner().intern(target_user);
                 client.role     = role;
                 res = {{"status", "ok"}, {"role", role}};
             } else {
@@ -231,7 +348,7 @@ void handle_client_message(int sockfd) {
         if (is_new_game) {
             if (!owner.empty()) {
                 std::string msg;
-                if (owner == client.username) {
+                if (owner == client.username()) {
                     msg = "Failed: You already have a game named '" + game_name + "'. Please use 'Update Game'.";
                 } else {
                     msg = "Failed: Game name '" + game_name + "' is already taken by another developer.";
@@ -246,7 +363,7 @@ void handle_client_message(int sockfd) {
                 send_message(sockfd, res.dump());
                 return;
             }
-            if (owner != client.username) {
+            if (owner != client.username()) {
                 res = {{"status", "error"}, {"message", "Failed: Permission Denied. You do not own this game."}};
                 send_message(sockfd, res.dump());
                 return;
@@ -272,11 +389,18 @@ void handle_client_message(int sockfd) {
         int port = ntohs(sa.sin_port); 
 
         std::string save_path = "server/uploaded_games/" + filename;
+        std::string old_filename = db.get_game_filename(game_name);
+        std::string old_path = old_filename.empty() ? save_path : "server/uploaded_games/" + old_filename;
         
-        std::thread(handle_file_upload_connection, transfer_sock, save_path, filesize).detach();
+        uint32_t expected_crc = req.value("crc32c", 0u);
+        transfers.start_upload(transfer_sock, save_path, filesize, client.username(),
+                               req.contains("crc32c") ? &expected_crc : nullptr,
+                               [save_path, old_path](bool ok, const FileChecksums& checksums) {
+                                   finish_upload(save_path, old_path, ok, checksums);
+                               });
 
         db.upsert_game(
-            client.username,
+            client.username(),
             game_name,
             req.value("description", ""),
             filename,
@@ -298,32 +422,61 @@ void handle_client_message(int sockfd) {
             res = {{"status", "error"}, {"message", "Game not found in DB"}};
         } else {
             std::string filepath = "server/uploaded_games/" + filename;
-            long fsize = get_file_size_force(filepath);
+            long raw_size = get_file_size(filepath);
+
+            Encoding enc = Encoding::IDENTITY;
+            std::shared_ptr<const MappedFile> blob;
+            if (raw_size >= 0) blob = negotiate_artifact(req, filepath, enc);
             
-            if (fsize < 0) {
+            if (!blob) {
                 char cwd[1024];
                 if (getcwd(cwd, sizeof(cwd)) != NULL) {
                     std::cout << "[Error] File missing at: " << cwd << "/" << filepath << std::endl;
                 }
                 res = {{"status", "error"}, {"message", "File missing on server"}};
             } else {
-                db.record_download(gamename, client.username);
+                db.record_download(gamename, client.username());
+
+                long fsize = blob->size;
+                int streams = std::clamp(req.value("streams", 1), 1, MAX_DOWNLOAD_STREAMS);
+                long useful_streams = std::max<long>(1, (fsize + MIN_CHUNK_SIZE - 1) / MIN_CHUNK_SIZE);
+                streams = (int)std::min<long>(streams, useful_streams);
+                // Chunks end on checksum block boundaries, so their CRCs are
+                // combined from the stored block CRCs.
+                size_t block = FileChecksums::BLOCK;
+                size_t chunk_size = ((fsize + streams - 1) / streams + block - 1) / block * block;
+                if (chunk_size > 0) streams = (int)((fsize + chunk_size - 1) / chunk_size);
+
                 int transfer_sock = socket(AF_INET, SOCK_STREAM, 0);
                 struct sockaddr_in sa = {0}; sa.sin_family=AF_INET; sa.sin_addr.s_addr=INADDR_ANY;
                 
                 sa.sin_port = 0; 
                 
                 bind(transfer_sock, (struct sockaddr*)&sa, sizeof(sa));
-                listen(transfer_sock, 1);
+                listen(transfer_sock, streams);
                 
                 socklen_t len = sizeof(sa); 
                 getsockname(transfer_sock, (struct sockaddr*)&sa, &len);
                 int port = ntohs(sa.sin_port);
 
-                std::cout << "[System] Ready to send " << filename << " (" << fsize << " bytes) on port " << port << std::endl;
-                std::thread(handle_file_download_connection, transfer_sock, filepath).detach();
+                std::cout << "[System] Ready to send " << filename << " (" << fsize << " bytes " << encoding_name(enc)
+                          << ", " << streams << " streams) on port " << port << std::endl;
+                // Only a player fetching the game of the room it sits in gets the
+                // room weight; the class is never taken from the request.
+                bool for_room = client.state == ClientState::IN_ROOM &&
+                                room_mgr.get_room_game_name(client.room_id) == gamename;
+                TransferClass cls = for_room ? TransferClass::ROOM_DOWNLOAD : TransferClass::STORE_DOWNLOAD;
+                transfers.start_download(transfer_sock, blob, filepath, streams, chunk_size, client.username(), cls);
                 
-                res = {{"status", "ok"}, {"port", port}, {"filesize", fsize}, {"filename", filename}};
+                res = {
+                    {"status", "ok"}, {"port", port}, {"filesize", fsize}, {"filename", filename},
+                    {"streams", streams}, {"chunk_size", chunk_size},
+                    {"encoding", encoding_name(enc)}, {"raw_size", raw_size}
+                };
+                if (blob->checksums) {
+                    res["crc32c"] = blob->checksums->whole;
+                    if (streams > 1) res["chunk_crc32c"] = blob->chunk_crcs(chunk_size);
+                }
             }
         }
         send_message(sockfd, res.dump());
@@ -337,11 +490,17 @@ void handle_client_message(int sockfd) {
                 {"message", "Failed: Game is currently active in a room. Please wait for matches to finish."}
             };
         } else {
-            std::string filename = db.delete_game(client.username, game_name);
+            std::string filename = db.delete_game(client.username(), game_name);
 
             if (!filename.empty()) {
                 std::string filepath = "server/uploaded_games/" + filename;
-                remove(filepath.c_str());
+                {
+                    std::lock_guard<std::mutex> lock(artifact_mutex);
+                    remove_compressed_artifacts(filepath);
+                    remove(filepath.c_str());
+                    remove((filepath + ".crc").c_str());
+                }
+                file_cache.invalidate(filepath);
 
                 res = {{"status", "ok"}, {"message", "Game deleted successfully"}};
                 std::cout << "[System] Deleted game file: " << filepath << std::endl;
@@ -356,18 +515,88 @@ void handle_client_message(int sockfd) {
         send_message(sockfd, res.dump());
     }
     else if (action == "list_games") {
-        res = {{"status", "ok"}, {"data", db.get_games()}};
+        send_message(sockfd, *db.get_catalog_response());
+    }
+    else if (action == "list_my_games") {
+        res = {{"status", "ok"}, {"data", db.list_dev_games(client.username())}};
+        send_message(sockfd, res.dump());
+    }
+    else if (action == "get_comments") {
+        std::string gname = req.value("game_name", "");
+        CommentOrder order = req.value("sort", "newest") == "score" ? CommentOrder::SCORE : CommentOrder::NEWEST;
+        int offset = std::max(0, req.value("offset", 0));
+        int limit  = std::clamp(req.value("limit", COMMENTS_PAGE_DEFAULT), 1, COMMENTS_PAGE_MAX);
+
+        json page = db.get_comments(gname, order, offset, limit);
+        if (page.is_null()) {
+            res = {{"status", "error"}, {"message", "Game not found"}};
+        } else {
+            res = {{"status", "ok"}, {"data", page}};
+        }
+        send_message(sockfd, res.dump());
+    }
+    else if (action == "search_games") {
+        std::string query = req.value("query", "");
+        int limit = std::clamp(req.value("limit", SEARCH_RESULTS_DEFAULT), 1, SEARCH_RESULTS_MAX);
+        res = {{"status", "ok"}, {"data", db.search_games(query, limit)}};
+        send_message(sockfd, res.dump());
+    }
+    else if (action == "top_games") {
+        int limit = std::clamp(req.value("limit", TOP_GAMES_DEFAULT), 1, TOP_GAMES_MAX);
+        json list = db.top_games(req.value("by", "downloads"), limit);
+        if (list.is_null()) {
+            res = {{"status", "error"}, {"message", "Unknown ranking"}};
+        } else {
+            res = {{"status", "ok"}, {"data", list}};
+        }
+        send_message(sockfd, res.dump());
+    }
+    else if (action == "recommend") {
+        // With game_name: players of that game also played. Without: picks for
+        // the logged-in user.
+        int limit = std::clamp(req.value("limit", RECOMMEND_DEFAULT), 1, RECOMMEND_MAX);
+        std::string gname = req.value("game_name", "");
+        json list = gname.empty() ? db.recommend(client.username(), limit) : db.also_played(gname, limit);
+        if (list.is_null()) {
+            res = {{"status", "error"}, {"message", "Game not found"}};
+        } else {
+            res = {{"status", "ok"}, {"data", list}};
+        }
+        send_message(sockfd, res.dump());
+    }
+    else if (action == "game_stats") {
+        // Developers only see the activity of their own games.
+        std::string gname = req.value("game_name", "");
+        json stats;
+        if (db.get_game_owner(gname) == client.username()) stats = db.game_stats(gname);
+        if (stats.is_null()) {
+            res = {{"status", "error"}, {"message", "Permission Denied: You do not own this game or it does not exist."}};
+        } else {
+            res = {{"status", "ok"}, {"data", stats}};
+        }
+        send_message(sockfd, res.dump());
+    }
+    else if (action == "server_stats") {
+        json stats;
+        stats["file_cache"] = file_cache.stats();
+        stats["transfers"] = transfer_sched.stats();
+        stats["transfer_reactors"] = transfers.stats();
+        stats["artifact_jobs_pending"] = artifact_jobs.pending();
+        stats["db"] = db.stats();
+        res = {{"status", "ok"}, {"data", stats}};
         send_message(sockfd, res.dump());
     }
     else if (action == "create_room") {
         std::string rname = req["room_name"];
         std::string gname = req["game_name"];
 
-        if (db.get_game_filename(gname).empty()) {
+        if (client.state == ClientState::CONNECTED) {
+            res = {{"status", "error"}, {"message", "Please log in first."}};
+        } else if (db.get_game_filename(gname).empty()) {
             res = {{"status", "error"}, {"message", "Game not found"}};
         } else {
             int max_players = db.get_game_max_players(gname);
-            int rid = room_mgr.create_room(rname, client.username, gname, max_players);
+            int rid = room_mgr.create_room(rname, client.user_id, gname, max_players);
             
             client.state   = ClientState::IN_ROOM;
             client.room_id = rid;
@@ -388,8 +617,8 @@ void handle_client_message(int sockfd) {
     else if (action == "list_players") {
         std::vector<std::string> player_names;
         for (const auto& [id, info] : clients) {
-            if (!info.username.empty() && info.role == "player") {
-                player_names.push_back(info.username);
+            if (info.user_id != StringInterner::NONE && info.role == "player") {
+                player_names.push_back(info.username());
             }
         }
         res = {{"status", "ok"}, {"data", player_names}};
@@ -398,7 +627,9 @@ void handle_client_message(int sockfd) {
     else if (action == "join_room") {
         int rid = req["room_id"];
 
-        if (room_mgr.join_room(rid, client.username)) {
+        if (client.state == ClientState::CONNECTED) {
+            res = {{"status", "error"}, {"message", "Please log in first."}};
+        } else if (room_mgr.join_room(rid, client.user_id)) {
             client.state   = ClientState::IN_ROOM;
             client.room_id = rid;
 
@@ -406,7 +637,7 @@ void handle_client_message(int sockfd) {
 
             json notify;
             notify["action"]   = "player_joined";
-            notify["username"] = client.username;
+            notify["username"] = client.username();
             notify["data"]     = room_mgr.get_room_info(rid);
 
             for (auto& [id, info] : clients) {
@@ -423,14 +654,14 @@ void handle_client_message(int sockfd) {
     else if (action == "leave_room") {
         if (client.room_id != -1) {
             int rid = client.room_id;
-            int ret = room_mgr.leave_room(rid, client.username);
+            int ret = room_mgr.leave_room(rid, client.user_id);
 
             json notify;
             if (ret == 1) {
                 notify["action"] = "room_disbanded";
             } else {
                 notify["action"]   = "player_left";
-                notify["username"] = client.username;
+                notify["username"] = client.username();
                 notify["data"]     = room_mgr.get_room_info(rid);
             }
 
@@ -456,7 +687,7 @@ void handle_client_message(int sockfd) {
         if (client.room_id != -1) {
             json info = room_mgr.get_room_info(client.room_id);
 
-            if (info["host"] == client.username) {
+            if (room_mgr.is_host(client.room_id, client.user_id)) {
                 if (!room_mgr.is_room_full(client.room_id)) {
                     res = {
                         {"status", "error"}, 
@@ -476,6 +707,7 @@ void handle_client_message(int sockfd) {
                     }
 
                     room_mgr.start_game(client.room_id, game_port);
+                    db.record_match_started(info["game"]);
 
                     json broadcast;
                     broadcast["action"]    = "game_start";
@@ -495,12 +727,10 @@ void handle_client_message(int sockfd) {
         if (client.room_id != -1) {
             json info = room_mgr.get_room_info(client.room_id);
 
-            if (info["host"] == client.username) {
+            if (room_mgr.is_host(client.room_id, client.user_id)) {
                 room_mgr.finish_game(client.room_id);
                 std::string gname = info["game"];
-                for (const auto& p : info["players"]) {
-                    db.record_play_history(p.get<std::string>(), gname);
-                }
+                db.record_play_history(info["players"].get<std::vector<std::string>>(), gname);
 
                 json notify;
                 notify["action"] = "room_reset";
@@ -518,13 +748,15 @@ void handle_client_message(int sockfd) {
         std::string gname = req["game_name"];
         int score = req["score"];
         std::string content = req["content"];
-        if (!db.has_played(client.username, gname)) {
+        if (!RatingAggregate::valid(score)) {
+            res = {{"status", "error"}, {"message", "Score must be between 1 and 5."}};
+        } else if (!db.has_played(client.username(), gname)) {
             res = {
                 {"status", "error"}, 
                 {"message", "You must play this game before rating it!"}
             };
         } else {
-            if (db.add_comment(gname, client.username, score, content)) {
+            if (db.add_comment(gname, client.username(), score, content)) {
                 res = {{"status", "ok"}, {"message", "Comment added successfully"}};
             } else {
                 res = {{"status", "error"}, {"message", "You have already rated this game or game not found."}};
@@ -534,11 +766,11 @@ void handle_client_message(int sockfd) {
     }
     else if (action == "logout") {
         if (client.room_id != -1) {
-            room_mgr.leave_room(client.room_id, client.username);
+            room_mgr.leave_room(client.room_id, client.user_id);
         }
 
         client.state    = ClientState::CONNECTED;
-        client.username = "";
+        client.user_id  = StringInterner::NONE;
         client.room_id  = -1;
 
         res = {{"status", "ok"}};
@@ -548,7 +780,11 @@ void handle_client_message(int sockfd) {
 
 int main() {
     signal(SIGCHLD, handle_sigchld);
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
     ensure_directory_exists("server/uploaded_games");
+    prepare_compressed_artifacts("server/uploaded_games");
 
     int listener = socket(AF_INET, SOCK_STREAM, 0);
 
@@ -573,7 +809,7 @@ int main() {
 
     std::cout << "Lobby Server (Full Features) running on " << SERVER_PORT << std::endl;
 
-    while (true) {
+    while (!stop_requested) {
         fd_set read_fds = master_fds;
 
         if (select(fdmax + 1, &read_fds, NULL, NULL, NULL) == -1) {
@@ -590,6 +826,10 @@ int main() {
 
                     int newfd = accept(listener, (struct sockaddr*)&cli_addr, &len);
                     if (newfd >= 0) {
+                        int one = 1;
+                        setsockopt(newfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                        set_socket_tos(newfd, IPTOS_LOWDELAY);
+
                         FD_SET(newfd, &master_fds);
                         if (newfd > fdmax) fdmax = newfd;
 
@@ -603,5 +843,7 @@ int main() {
         }
     }
 
+    std::cout << "Shutting down, flushing database..." << std::endl;
+    db.flush();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "db.hpp"
+#include <iostream>
+#include <sys/stat.h>
+
+// Converts the JSON engine's data (database.snap if present, else
+// database.json, plus any pending write-ahead log) into a SQLite database for
+// GAMESTORE_DB_ENGINE=sqlite. The source files are only read.
+//   ./migrate_app [database.json] [database.sqlite]
+int main(int argc, char* argv[]) {
+    DbOptions src_opts;
+    src_opts.engine = "json";
+    src_opts.read_only = true;
+    if (argc > 1) src_opts.json_path = argv[1];
+    std::string dst_path = argc > 2 ? argv[2] : src_opts.sqlite_path;
+
+    struct stat st;
+    if (stat(dst_path.c_str(), &st) == 0) {
+        std::cerr << "Error: " << dst_path << " already exists, refusing to overwrite." << std::endl;
+        return 1;
+    }
+
+    json snapshot;
+    {
+        Database src(src_opts);
+        snapshot = src.export_snapshot();
+    }
+
+    SqliteStorage dst(dst_path, std::chrono::microseconds(0), 1, false);
+    if (!dst.ok() || !dst.import_snapshot(snapshot)) {
+        std::cerr << "Error: migration into " << dst_path << " failed." << std::endl;
+        return 1;
+    }
+
+    std::cout << "Migrated " << snapshot["users"].size() << " users and "
+              << snapshot["games"].size() << " games (LSN " << snapshot["lsn"]
+              << ") into " << dst_path << std::endl;
+    return 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+
+// Ids ordered by score (highest first, lower id first among equal scores).
+// Updating a score is O(log n) and the top n are the first n entries, so a
+// ranking never needs a pass over the whole catalog.
+class Ranking {
+private:
+    struct Entry {
+        double score;
+        uint32_t id;
+
+        bool operator<(const Entry& o) const {
+            return score != o.score ? score > o.score : id < o.id;
+        }
+    };
+
+    std::set<Entry> order;
+    std::unordered_map<uint32_t, double> scores;
+
+public:
+    void set(uint32_t id, double score) {
+        auto it = scores.find(id);
+        if (it != scores.end()) {
+            if (it->second == score) return;
+            order.erase({it->second, id});
+            it->second = score;
+        } else {
+            scores.emplace(id, score);
+        }
+        order.insert({score, id});
+    }
+
+    void remove(uint32_t id) {
+        auto it = scores.find(id);
+        if (it == scores.end()) return;
+        order.erase({it->second, id});
+        scores.erase(it);
+    }
+
+    // Visits up to `n` (id, score) pairs, best first.
+    template <typename Fn>
+    void top(size_t n, Fn&& fn) const {
+        for (auto it = order.begin(); it != order.end() && n > 0; ++it, --n) fn(it->id, it->score);
+    }
+
+    // Visits (id, score) pairs best first until `fn` returns false, for callers
+    // that skip some entries and cannot know up front how many they need.
+    template <typename Fn>
+    void visit(Fn&& fn) const {
+        for (const auto& e : order) {
+            if (!fn(e.id, e.score)) return;
+        }
+    }
+
+    size_t size() const { return order.size(); }
+};
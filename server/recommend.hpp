@@ -0,0 +1,167 @@
+#pragma once
+#include "bitmap.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// One sparse entry of a co-play row: `count` users played both games.
+struct CoPlayCount {
+    uint32_t game;
+    uint32_t count;
+};
+
+// "Players who played X also played Y": for every pair of games, how many users
+// have played both. Counts are stored sparsely, one row per game sorted by the
+// other game's id, and each row also keeps its ITEM_TOP_K strongest neighbours
+// in order. Counts only grow while both games exist, so checking a pair against
+// its row's top list whenever it changes keeps that list exact without
+// rescanning the row; deleting a game rebuilds the lists it was in.
+class CoPlayIndex {
+public:
+    static constexpr size_t ITEM_TOP_K = 32;
+
+private:
+    struct Row {
+        std::vector<CoPlayCount> counts;  // by game id
+        std::vector<CoPlayCount> top;     // highest count first
+    };
+
+    std::unordered_map<uint32_t, Row> rows;
+
+    static void bump(Row& row, uint32_t other) {
+        auto pos = std::lower_bound(row.counts.begin(), row.counts.end(), other,
+                                    [](const CoPlayCount& c, uint32_t g) { return c.game < g; });
+        if (pos == row.counts.end() || pos->game != other) pos = row.counts.insert(pos, {other, 0});
+        uint32_t count = ++pos->count;
+
+        auto it = std::find_if(row.top.begin(), row.top.end(), [&](const CoPlayCount& n) { return n.game == other; });
+        if (it != row.top.end()) {
+            it->count = count;
+        } else if (row.top.size() < ITEM_TOP_K) {
+            row.top.push_back({other, count});
+            it = row.top.end() - 1;
+        } else if (count > row.top.back().count) {
+            row.top.back() = {other, count};
+            it = row.top.end() - 1;
+        } else {
+            return;
+        }
+        for (; it != row.top.begin() && (it - 1)->count < it->count; --it) std::iter_swap(it, it - 1);
+    }
+
+    static void rebuild_top(Row& row) {
+        size_t k = std::min(ITEM_TOP_K, row.counts.size());
+        row.top.resize(k);
+        std::partial_sort_copy(row.counts.begin(), row.counts.end(), row.top.begin(), row.top.end(),
+                               [](const CoPlayCount& a, const CoPlayCount& b) { return a.count > b.count; });
+    }
+
+public:
+    // A user whose history is `played` has just played `game` for the first time.
+    // Only partners for which `live(other)` holds (games still in the catalog)
+    // are counted.
+    template <typename Live>
+    void add_play(const RoaringBitmap& played, uint32_t game, Live&& live) {
+        played.for_each([&](uint32_t other) {
+            if (other == game || !live(other)) return;
+            bump(rows[game], other);
+            bump(rows[other], game);
+        });
+    }
+
+    // Recounts everything from the users' histories. Rows are split across
+    // `threads` workers by game id, so every worker writes only its own rows:
+    // it gathers each row's partner ids, sorts them and counts the runs.
+    void build(const std::vector<const RoaringBitmap*>& histories, unsigned threads) {
+        rows.clear();
+        for (auto* h : histories) {
+            if (h->cardinality() < 2) continue;
+            h->for_each([&](uint32_t g) { rows[g]; });
+        }
+        threads = std::max(1u, std::min<unsigned>(threads, rows.size()));
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                std::unordered_map<uint32_t, std::vector<uint32_t>> partners;
+                std::vector<uint32_t> games;
+                for (auto* h : histories) {
+                    if (h->cardinality() < 2) continue;
+                    games.clear();
+                    h->for_each([&](uint32_t g) { games.push_back(g); });
+                    for (uint32_t a : games) {
+                        if (a % threads != t) continue;
+                        auto& list = partners[a];
+                        for (uint32_t b : games) {
+                            if (b != a) list.push_back(b);
+                        }
+                    }
+                }
+                for (auto& [game, list] : partners) {
+                    std::sort(list.begin(), list.end());
+                    Row& row = rows.find(game)->second;
+                    for (size_t i = 0; i < list.size();) {
+                        size_t j = i;
+                        while (j < list.size() && list[j] == list[i]) j++;
+                        row.counts.push_back({list[i], (uint32_t)(j - i)});
+                        i = j;
+                    }
+                    std::vector<uint32_t>().swap(list);
+                    rebuild_top(row);
+                }
+            });
+        }
+        for (auto& w : workers) w.join();
+    }
+
+    // Forgets a deleted game: drops its row and its entry in every partner row,
+    // rebuilding the partner's top list if the game was in it.
+    void remove_game(uint32_t game) {
+        auto it = rows.find(game);
+        if (it == rows.end()) return;
+        for (const auto& c : it->second.counts) {
+            auto partner = rows.find(c.game);
+            if (partner == rows.end()) continue;
+            Row& row = partner->second;
+            auto pos = std::lower_bound(row.counts.begin(), row.counts.end(), game,
+                                        [](const CoPlayCount& n, uint32_t g) { return n.game < g; });
+            if (pos == row.counts.end() || pos->game != game) continue;
+            row.counts.erase(pos);
+            if (row.counts.empty()) {
+                rows.erase(partner);
+            } else if (std::any_of(row.top.begin(), row.top.end(), [&](const CoPlayCount& n) { return n.game == game; })) {
+                rebuild_top(row);
+            }
+        }
+        rows.erase(game);
+    }
+
+    // Installs a saved row; `counts` must be sorted by game id.
+    void set_row(uint32_t game, std::vector<CoPlayCount> counts) {
+        Row& row = rows[game];
+        row.counts = std::move(counts);
+        rebuild_top(row);
+    }
+
+    // Visits every row as (game, counts sorted by game id).
+    template <typename Fn>
+    void for_each_row(Fn&& fn) const {
+        for (const auto& [game, row] : rows) fn(game, row.counts);
+    }
+
+    // Visits the game's strongest neighbours as (game, co-players), best first.
+    template <typename Fn>
+    void neighbors(uint32_t game, Fn&& fn) const {
+        auto it = rows.find(game);
+        if (it == rows.end()) return;
+        for (const auto& n : it->second.top) fn(n.game, n.count);
+    }
+
+    size_t pairs() const {
+        size_t n = 0;
+        for (const auto& [game, row] : rows) n += row.counts.size();
+        return n;
+    }
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include "bitmap.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Comment {
+    uint32_t user;
+    int score;
+    std::string content;
+};
+
+// Running rating totals, so listing never walks the comments.
+struct RatingAggregate {
+    int64_t sum = 0;
+    uint32_t count = 0;
+    uint32_t histogram[5] = {0, 0, 0, 0, 0};
+
+    // Ratings are 1..5 stars; anything else is rejected before it is stored
+    // and skipped when loading, so sum/count always agree with the histogram.
+    static bool valid(int score) { return score >= 1 && score <= 5; }
+
+    void add(int score) {
+        sum += score;
+        count++;
+        histogram[score - 1]++;
+    }
+
+    float average() const {
+        return count ? (float)sum / count : 0.0f;
+    }
+};
+
+enum class CommentOrder {
+    NEWEST,
+    SCORE
+};
+
+// A game's comments in arrival order, plus positions kept sorted by score
+// (highest first, newer first among equal scores) so either order pages directly.
+class CommentStore {
+private:
+    std::vector<Comment> comments;
+    std::vector<uint32_t> by_score;
+
+public:
+    void add(Comment c) {
+        uint32_t pos = comments.size();
+        auto it = std::upper_bound(by_score.begin(), by_score.end(), c.score,
+                                   [this](int score, uint32_t p) { return score >= comments[p].score; });
+        by_score.insert(it, pos);
+        comments.push_back(std::move(c));
+    }
+
+    size_t size() const { return comments.size(); }
+
+    const std::vector<Comment>& all() const { return comments; }
+
+    const std::vector<uint32_t>& score_order() const { return by_score; }
+
+    // Restores a store saved as all() + score_order(), skipping the re-sort.
+    void assign(std::vector<Comment> saved, std::vector<uint32_t> saved_order) {
+        comments = std::move(saved);
+        by_score = std::move(saved_order);
+    }
+
+    template <typename Fn>
+    void page(CommentOrder order, size_t offset, size_t limit, Fn&& fn) const {
+        size_t n = comments.size();
+        for (size_t i = offset; i < n && i < offset + limit; i++) {
+            fn(comments[order == CommentOrder::NEWEST ? n - 1 - i : by_score[i]]);
+        }
+    }
+};
+
+struct GameRecord {
+    uint32_t name;
+    uint32_t dev;
+    uint32_t version;
+    uint32_t game_type;
+    int max_players = 2;
+    int downloads = 0;
+    std::string description;
+    std::string filename;
+    CommentStore comments;
+    // Interned user ids.
+    RoaringBitmap commenters;
+    RoaringBitmap downloaded_by;
+    RatingAggregate rating;
+    // log(sum of plays * e^(lambda * t)) over finished matches; -inf before the
+    // first one. Kept in the log domain so it never needs rescaling as time passes.
+    double play_trend = -INFINITY;
+};
+
+struct UserRecord {
+    uint32_t username;
+    uint32_t role;
+    std::string password;
+    // Interned game names.
+    RoaringBitmap play_history;
+};
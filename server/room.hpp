@@ -1,5 +1,6 @@
 #pragma once
 #include "../json.hpp"
+#include "interner.hpp"
 #include <vector>
 #include <string>
 #include <mutex>
@@ -8,15 +9,17 @@
 
 using json = nlohmann::json;
 
+// User and game names are ids from name_interner(); they are turned back into
+// strings only when a room is serialized for a client.
 struct Room {
     int id;
     std::string name;
-    std::string host_user;
-    std::string game_name; 
+    uint32_t host_user;
+    uint32_t game_name;
     std::string status;
     int game_port;         
     int max_players;
-    std::vector<std::string> players;
+    std::vector<uint32_t> players;
 };
 
 class RoomManager {
@@ -25,7 +28,7 @@ private:
     std::mutex room_mutex;
 
 public:
-    int create_room(std::string name, std::string host, std::string game_name, int max_players) {
+    int create_room(std::string name, uint32_t host, const std::string& game_name, int max_players) {
         std::lock_guard<std::mutex> lock(room_mutex);
         
         int id = 1;
@@ -37,7 +40,7 @@ public:
         r.id = id;
         r.name = name;
         r.host_user = host;
-        r.game_name = game_name;
+        r.game_name = name_interner().intern(game_name);
         r.status = "idle";
         r.game_port = 0;
         r.max_players = max_players;
@@ -47,7 +50,7 @@ public:
         return id;
     }
 
-    bool join_room(int room_id, std::string user) {
+    bool join_room(int room_id, uint32_t user) {
         std::lock_guard<std::mutex> lock(room_mutex);
         if (rooms.find(room_id) == rooms.end()) return false;
         
@@ -69,7 +72,7 @@ public:
         return rooms[room_id].players.size() == (size_t)rooms[room_id].max_players;
     }
 
-    int leave_room(int room_id, std::string user) {
+    int leave_room(int room_id, uint32_t user) {
         std::lock_guard<std::mutex> lock(room_mutex);
         if (rooms.find(room_id) == rooms.end()) return -1;
 
@@ -99,7 +102,7 @@ public:
             json item;
             item["id"] = r.id;
             item["name"] = r.name;
-            item["game"] = r.game_name;
+            item["game"] = name_interner().str(r.game_name);
             item["status"] = r.status;
             item["players"] = r.players.size();
             item["max_players"] = r.max_players;
@@ -116,15 +119,23 @@ public:
         json info;
         info["id"] = r.id;
         info["name"] = r.name;
-        info["host"] = r.host_user;
-        info["game"] = r.game_name;
+        info["host"] = name_interner().str(r.host_user);
+        info["game"] = name_interner().str(r.game_name);
         info["status"] = r.status;
-        info["players"] = r.players;
+        json players = json::array();
+        for (uint32_t p : r.players) players.push_back(name_interner().str(p));
+        info["players"] = players;
         info["max_players"] = r.max_players;
         info["game_port"] = r.game_port; 
         return info;
     }
 
+    bool is_host(int room_id, uint32_t user) {
+        std::lock_guard<std::mutex> lock(room_mutex);
+        auto it = rooms.find(room_id);
+        return it != rooms.end() && it->second.host_user == user;
+    }
+
     bool start_game(int room_id, int port) {
         std::lock_guard<std::mutex> lock(room_mutex);
         if (rooms.find(room_id) == rooms.end()) return false;
@@ -142,9 +153,10 @@ public:
     }
 
     bool is_game_active(const std::string& game_name) {
+        uint32_t game = name_interner().find(game_name);
         std::lock_guard<std::mutex> lock(room_mutex);
         for (auto const& [id, r] : rooms) {
-            if (r.game_name == game_name) {
+            if (r.game_name == game) {
                 return true; 
             }
         }
@@ -154,6 +166,6 @@ public:
     std::string get_room_game_name(int room_id) {
         std::lock_guard<std::mutex> lock(room_mutex);
         if (rooms.find(room_id) == rooms.end()) return "";
-        return rooms[room_id].game_name;
+        return name_interner().str(rooms[room_id].game_name);
     }
 };
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+#include <mutex>
+#include <shared_mutex>
+
+// Writer-preferring reader/writer lock. std::shared_mutex maps to a
+// reader-preferring pthread rwlock on glibc, which lets a steady stream of
+// readers starve writers indefinitely. Here a writer holds the turnstile for
+// its whole critical section, so readers arriving after it queue behind it.
+// Usable with std::shared_lock / std::unique_lock.
+class FairSharedMutex {
+private:
+    std::mutex turnstile;
+    std::shared_mutex rw;
+
+public:
+    void lock() {
+        turnstile.lock();
+        rw.lock();
+    }
+
+    void unlock() {
+        rw.unlock();
+        turnstile.unlock();
+    }
+
+    void lock_shared() {
+        turnstile.lock();
+        turnstile.unlock();
+        rw.lock_shared();
+    }
+
+    void unlock_shared() {
+        rw.unlock_shared();
+    }
+};
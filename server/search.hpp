@@ -0,0 +1,301 @@
+#pragma once
+#include "bitmap.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// In-memory inverted index over each game's name, developer and description.
+// Documents are keyed by interned game name, so ids survive catalog reordering.
+//
+// A query is split into lowercase terms and every term must match the game,
+// either exactly, as a prefix of an indexed term, or within one edit (looked up
+// through a single-deletion neighbourhood, so no dictionary scan is needed).
+// A term with none of those falls back to indexed terms that contain it, found
+// by a memmem() sweep over the packed vocabulary.
+class SearchIndex {
+private:
+    static constexpr size_t EXPANSIONS_MAX = 128;
+    static constexpr size_t TYPO_MIN_LEN = 4;
+    static constexpr size_t SUBSTRING_MIN_LEN = 3;
+    static constexpr int EXACT_WEIGHT = 4;
+    static constexpr int PREFIX_WEIGHT = 2;
+    static constexpr int FUZZY_WEIGHT = 1;
+
+    struct Posting {
+        RoaringBitmap docs;
+        // Subset of docs with the term in the game's name; those score double.
+        RoaringBitmap in_name;
+    };
+
+    struct TermMatch {
+        const std::string* term;
+        const Posting* posting;
+        int weight;
+    };
+
+    // Ordered so prefix matches are one contiguous range.
+    std::map<std::string, Posting> postings;
+    // Each indexed term under every spelling with one character removed.
+    std::unordered_map<std::string, std::vector<std::string>> deletes;
+    // Every term ever indexed, '\n'-separated, for substring matching. Removed
+    // terms stay until they make up half of it and it is repacked.
+    std::string vocabulary = "\n";
+    size_t vocabulary_dead = 0;
+    std::unordered_map<uint32_t, std::vector<std::string>> doc_terms;
+
+    static std::vector<std::string> tokenize(const std::string& s) {
+        std::vector<std::string> out;
+        std::string cur;
+        for (unsigned char c : s) {
+            // Bytes >= 0x80 count as letters so UTF-8 words stay whole.
+            if (isalnum(c) || c >= 0x80) {
+                cur += (char)tolower(c);
+            } else if (!cur.empty()) {
+                out.push_back(std::move(cur));
+                cur.clear();
+            }
+        }
+        if (!cur.empty()) out.push_back(std::move(cur));
+        return out;
+    }
+
+    static void unique_terms(std::vector<std::string>& terms) {
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    }
+
+    static std::vector<std::string> deletions(const std::string& term) {
+        std::vector<std::string> out;
+        for (size_t i = 0; i < term.size(); i++) {
+            std::string d = term.substr(0, i) + term.substr(i + 1);
+            if (out.empty() || out.back() != d) out.push_back(std::move(d));
+        }
+        return out;
+    }
+
+    void add_term(const std::string& term, uint32_t id, bool in_name) {
+        auto it = postings.find(term);
+        if (it == postings.end()) {
+            it = postings.emplace(term, Posting()).first;
+            vocabulary += term;
+            vocabulary += '\n';
+            if (term.size() >= TYPO_MIN_LEN) {
+                for (auto& d : deletions(term)) deletes[d].push_back(term);
+            }
+        }
+        it->second.docs.add(id);
+        if (in_name) it->second.in_name.add(id);
+    }
+
+    void remove_term(const std::string& term, uint32_t id) {
+        auto it = postings.find(term);
+        if (it == postings.end()) return;
+        it->second.docs.remove(id);
+        it->second.in_name.remove(id);
+        if (!it->second.docs.empty()) return;
+
+        postings.erase(it);
+        vocabulary_dead += term.size() + 1;
+        if (vocabulary_dead * 2 > vocabulary.size()) repack_vocabulary();
+        if (term.size() < TYPO_MIN_LEN) return;
+        for (auto& d : deletions(term)) {
+            auto dit = deletes.find(d);
+            if (dit == deletes.end()) continue;
+            auto& terms = dit->second;
+            terms.erase(std::remove(terms.begin(), terms.end(), term), terms.end());
+            if (terms.empty()) deletes.erase(dit);
+        }
+    }
+
+    void repack_vocabulary() {
+        vocabulary = "\n";
+        for (auto& [term, posting] : postings) {
+            vocabulary += term;
+            vocabulary += '\n';
+        }
+        vocabulary_dead = 0;
+    }
+
+    void add_match(std::vector<TermMatch>& matches, const std::string& term, int weight) const {
+        auto it = postings.find(term);
+        if (it == postings.end()) return;
+        for (auto& m : matches) {
+            if (m.term == &it->first) {
+                m.weight = std::max(m.weight, weight);
+                return;
+            }
+        }
+        matches.push_back({&it->first, &it->second, weight});
+    }
+
+    void add_substring_matches(std::vector<TermMatch>& matches, const std::string& q) const {
+        const char* begin = vocabulary.data();
+        const char* end = begin + vocabulary.size();
+        const char* p = begin;
+        while (matches.size() < EXPANSIONS_MAX) {
+            p = (const char*)memmem(p, end - p, q.data(), q.size());
+            if (!p) break;
+            const char* start = (const char*)memrchr(begin, '\n', p - begin) + 1;
+            const char* stop = (const char*)memchr(p, '\n', end - p);
+            add_match(matches, std::string(start, stop), FUZZY_WEIGHT);
+            p = stop;
+        }
+    }
+
+    // Every indexed term the query term can stand for, with its match weight.
+    std::vector<TermMatch> expand(const std::string& q) const {
+        std::vector<TermMatch> matches;
+        add_match(matches, q, EXACT_WEIGHT);
+
+        for (auto it = postings.upper_bound(q); it != postings.end() && matches.size() < EXPANSIONS_MAX; ++it) {
+            if (it->first.compare(0, q.size(), q) != 0) break;
+            add_match(matches, it->first, PREFIX_WEIGHT);
+        }
+
+        if (q.size() >= TYPO_MIN_LEN) {
+            // Query is missing a character.
+            auto it = deletes.find(q);
+            if (it != deletes.end()) {
+                for (auto& t : it->second) add_match(matches, t, FUZZY_WEIGHT);
+            }
+            for (auto& d : deletions(q)) {
+                // Query has one extra character.
+                add_match(matches, d, FUZZY_WEIGHT);
+                // One character substituted or two adjacent ones swapped.
+                auto dit = deletes.find(d);
+                if (dit == deletes.end()) continue;
+                for (auto& t : dit->second) add_match(matches, t, FUZZY_WEIGHT);
+            }
+        }
+
+        if (matches.empty() && q.size() >= SUBSTRING_MIN_LEN) add_substring_matches(matches, q);
+        return matches;
+    }
+
+    // Best score of any of the term's matches in game `id`, 0 if none.
+    static int score(const std::vector<TermMatch>& matches, uint32_t id) {
+        int best = 0;
+        for (auto& m : matches) {
+            if (m.weight * 2 > best && m.posting->in_name.contains(id)) best = m.weight * 2;
+            else if (m.weight > best && m.posting->docs.contains(id)) best = m.weight;
+        }
+        return best;
+    }
+
+    static int max_score(const std::vector<TermMatch>& matches) {
+        int best = 0;
+        for (auto& m : matches) best = std::max(best, m.posting->in_name.empty() ? m.weight : m.weight * 2);
+        return best;
+    }
+
+public:
+    // Indexes a game, replacing whatever was indexed under `id` before.
+    void add(uint32_t id, const std::string& name, const std::string& dev, const std::string& description) {
+        remove(id);
+
+        std::vector<std::string> name_terms = tokenize(name);
+        unique_terms(name_terms);
+        std::vector<std::string> terms = name_terms;
+        for (auto& t : tokenize(dev)) terms.push_back(std::move(t));
+        for (auto& t : tokenize(description)) terms.push_back(std::move(t));
+        unique_terms(terms);
+
+        for (auto& t : terms) {
+            add_term(t, id, std::binary_search(name_terms.begin(), name_terms.end(), t));
+        }
+        doc_terms.emplace(id, std::move(terms));
+    }
+
+    void remove(uint32_t id) {
+        auto it = doc_terms.find(id);
+        if (it == doc_terms.end()) return;
+        for (auto& t : it->second) remove_term(t, id);
+        doc_terms.erase(it);
+    }
+
+    // Up to `limit` matching game ids, best match first (ties by id).
+    //
+    // Candidates come from the term with the fewest matches, visited in tiers of
+    // falling score (name matches, then the rest, exact before prefix before
+    // fuzzy). Once `limit` results are held and the best total a later tier
+    // could reach does not beat the weakest of them, the scan stops.
+    std::vector<uint32_t> search(const std::string& query, size_t limit) const {
+        std::vector<std::string> terms = tokenize(query);
+        unique_terms(terms);
+        if (terms.empty() || limit == 0) return {};
+
+        std::vector<std::vector<TermMatch>> per_term;
+        for (auto& t : terms) {
+            per_term.push_back(expand(t));
+            if (per_term.back().empty()) return {};
+        }
+
+        size_t driver = 0;
+        std::vector<size_t> sizes;
+        for (auto& matches : per_term) {
+            size_t n = 0;
+            for (auto& m : matches) n += m.posting->docs.cardinality();
+            sizes.push_back(n);
+        }
+        for (size_t i = 1; i < per_term.size(); i++) {
+            if (sizes[i] < sizes[driver]) driver = i;
+        }
+
+        int rest_bound = 0;
+        for (size_t i = 0; i < per_term.size(); i++) {
+            if (i != driver) rest_bound += max_score(per_term[i]);
+        }
+
+        std::vector<std::pair<int, const RoaringBitmap*>> tiers;
+        for (auto& m : per_term[driver]) {
+            if (!m.posting->in_name.empty()) tiers.push_back({m.weight * 2, &m.posting->in_name});
+            tiers.push_back({m.weight, &m.posting->docs});
+        }
+        std::stable_sort(tiers.begin(), tiers.end(),
+                         [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        // Min-heap of the best (score, -id) so far; its top is the one to evict.
+        using Hit = std::pair<int, int64_t>;
+        std::priority_queue<Hit, std::vector<Hit>, std::greater<Hit>> best;
+        std::unordered_set<uint32_t> seen;
+
+        for (auto& [tier_score, docs] : tiers) {
+            int bound = tier_score + rest_bound;
+            bool done = best.size() == limit && best.top().first >= bound;
+            docs->for_each([&](uint32_t id) {
+                if (done || !seen.insert(id).second) return;
+                int total = 0;
+                for (auto& matches : per_term) {
+                    int s = score(matches, id);
+                    if (s == 0) return;
+                    total += s;
+                }
+                Hit hit(total, -(int64_t)id);
+                if (best.size() < limit) best.push(hit);
+                else if (best.top() < hit) {
+                    best.pop();
+                    best.push(hit);
+                }
+                done = best.size() == limit && best.top().first >= bound;
+            });
+            if (done) break;
+        }
+
+        std::vector<uint32_t> ids(best.size());
+        for (size_t i = ids.size(); i-- > 0; best.pop()) ids[i] = (uint32_t)-best.top().second;
+        return ids;
+    }
+
+    size_t size() const { return doc_terms.size(); }
+
+    size_t term_count() const { return postings.size(); }
+};
@@ -0,0 +1,529 @@
+#pragma once
+#include "../checksum.hpp"
+#include "../json.hpp"
+#include "analytics.hpp"
+#include "interner.hpp"
+#include "recommend.hpp"
+#include "records.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <ostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#define SNAPSHOT_MAGIC 0x50414e53u  // "SNAP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_V1_HEADER_SIZE 160  // version 1 had no stats sections
+
+using json = nlohmann::json;
+
+// Binary database snapshot. The file is a fixed header followed by flat,
+// 8-byte aligned arrays of fixed-size records, so a mapped file is read in
+// place: nothing is parsed, strings are (offset, length) slices and lists are
+// ranges of a shared id pool.
+//
+//   names     every interned string, in interner id order, so loading into a
+//             fresh interner reproduces the ids one for one
+//   texts     passwords, descriptions, filenames and comment bodies
+//   users     SnapUser[]         games     SnapGame[]
+//   comments  SnapComment[], each game's run in arrival order
+//   ids       uint32 pool: play histories, downloaders and each game's
+//             comment positions by score (CommentStore's index, kept as is)
+//   coplay    SnapCoPlayRow[] over a CoPlayCount[] pool: the co-play index
+//             rows as stored in memory, so startup copies instead of recounting
+//   stats     SnapGameStats[] over a StatBucket[] pool: each game's non-empty
+//             hourly then daily analytics buckets
+//
+// Integers are host byte order; a foreign-endian file fails the magic check.
+struct SnapSection {
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct SnapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t lsn;
+    uint64_t size;
+    uint32_t crc;  // CRC32C of everything after the header
+    uint32_t reserved;
+    // String tables point at count + 1 uint64 offsets into a byte blob that
+    // follows them.
+    SnapSection names, texts, users, games, comments, ids, coplay_rows, coplay;
+    SnapSection stats_rows, stats;
+};
+
+struct SnapUser {
+    uint32_t username;
+    uint32_t role;
+    uint32_t password;
+    uint32_t history_count;
+    uint64_t history_offset;
+};
+
+struct SnapGame {
+    uint32_t name;
+    uint32_t dev;
+    uint32_t version;
+    uint32_t game_type;
+    int32_t max_players;
+    int32_t downloads;
+    uint32_t description;
+    uint32_t filename;
+    uint64_t comments_offset;
+    uint64_t score_order_offset;
+    uint64_t downloaders_offset;
+    uint32_t comments_count;
+    uint32_t downloaders_count;
+    double play_trend;
+};
+
+struct SnapComment {
+    uint32_t user;
+    int32_t score;
+    uint32_t content;
+    uint32_t reserved;
+};
+
+struct SnapCoPlayRow {
+    uint32_t game;
+    uint32_t count;
+    uint64_t offset;
+};
+
+struct SnapGameStats {
+    uint32_t game;
+    uint32_t hours;
+    uint32_t days;
+    uint32_t reserved;
+    uint64_t offset;
+};
+
+static_assert(sizeof(SnapHeader) == 192 && sizeof(SnapUser) == 24 && sizeof(SnapGame) == 72 &&
+              sizeof(SnapComment) == 16 && sizeof(SnapCoPlayRow) == 16 && sizeof(CoPlayCount) == 8 &&
+              sizeof(SnapGameStats) == 24 && sizeof(StatBucket) == 24,
+              "snapshot records must keep their on-disk size");
+
+class SnapshotWriter {
+private:
+    uint64_t lsn;
+    std::vector<uint64_t> name_offsets{0};
+    std::string name_blob;
+    std::vector<uint64_t> text_offsets{0};
+    std::string text_blob;
+    std::vector<SnapUser> users;
+    std::vector<SnapGame> games;
+    std::vector<SnapComment> comments;
+    std::vector<uint32_t> ids;
+    std::vector<SnapCoPlayRow> coplay_rows;
+    std::vector<CoPlayCount> coplay;
+    std::vector<SnapGameStats> stats_rows;
+    std::vector<StatBucket> stats;
+
+    uint32_t add_text(const std::string& s) {
+        text_blob += s;
+        text_offsets.push_back(text_blob.size());
+        return (uint32_t)text_offsets.size() - 2;
+    }
+
+    uint64_t add_ids(const RoaringBitmap& set) {
+        uint64_t offset = ids.size();
+        set.for_each([&](uint32_t id) { ids.push_back(id); });
+        return offset;
+    }
+
+    static void pad(std::string& out) {
+        out.resize((out.size() + 7) & ~(size_t)7, '\0');
+    }
+
+    // Moves `items` into the image; the staging copy is freed right away so
+    // finishing never holds the snapshot twice.
+    template <typename T>
+    static SnapSection append(std::string& out, std::vector<T>& items) {
+        pad(out);
+        SnapSection s{out.size(), items.size()};
+        out.append((const char*)items.data(), items.size() * sizeof(T));
+        std::vector<T>().swap(items);
+        return s;
+    }
+
+    static SnapSection append_strings(std::string& out, std::vector<uint64_t>& offsets, std::string& blob) {
+        size_t count = offsets.size() - 1;
+        SnapSection s = append(out, offsets);
+        s.count = count;
+        out += blob;
+        std::string().swap(blob);
+        return s;
+    }
+
+public:
+    // Interned ids are written as they are, so the whole interner goes in.
+    SnapshotWriter(const StringInterner& strings, uint64_t last_lsn) : lsn(last_lsn) {
+        for (size_t i = 0, n = strings.size(); i < n; i++) {
+            name_blob += strings.str(i);
+            name_offsets.push_back(name_blob.size());
+        }
+    }
+
+    void add_user(const UserRecord& u) {
+        SnapUser r{};
+        r.username = u.username;
+        r.role = u.role;
+        r.password = add_text(u.password);
+        r.history_count = (uint32_t)u.play_history.cardinality();
+        r.history_offset = add_ids(u.play_history);
+        users.push_back(r);
+    }
+
+    void add_game(const GameRecord& g) {
+        SnapGame r{};
+        r.name = g.name;
+        r.dev = g.dev;
+        r.version = g.version;
+        r.game_type = g.game_type;
+        r.max_players = g.max_players;
+        r.downloads = g.downloads;
+        r.description = add_text(g.description);
+        r.filename = add_text(g.filename);
+        r.comments_offset = comments.size();
+        r.comments_count = (uint32_t)g.comments.size();
+        for (const auto& c : g.comments.all()) comments.push_back({c.user, c.score, add_text(c.content), 0});
+        r.score_order_offset = ids.size();
+        ids.insert(ids.end(), g.comments.score_order().begin(), g.comments.score_order().end());
+        r.downloaders_count = (uint32_t)g.downloaded_by.cardinality();
+        r.downloaders_offset = add_ids(g.downloaded_by);
+        r.play_trend = g.play_trend;
+        games.push_back(r);
+    }
+
+    void add_coplay(const CoPlayIndex& index) {
+        index.for_each_row([&](uint32_t game, const std::vector<CoPlayCount>& counts) {
+            coplay_rows.push_back({game, (uint32_t)counts.size(), coplay.size()});
+            coplay.insert(coplay.end(), counts.begin(), counts.end());
+        });
+    }
+
+    void add_stats(uint32_t game, const GameAnalytics& analytics) {
+        std::vector<StatBucket> hours, days;
+        analytics.save(game, hours, days);
+        if (hours.empty() && days.empty()) return;
+        stats_rows.push_back({game, (uint32_t)hours.size(), (uint32_t)days.size(), 0, stats.size()});
+        stats.insert(stats.end(), hours.begin(), hours.end());
+        stats.insert(stats.end(), days.begin(), days.end());
+    }
+
+    // Builds the image; the writer is empty afterwards.
+    std::string finish() {
+        size_t total = sizeof(SnapHeader) + 8 * 11 + (name_offsets.size() + text_offsets.size()) * sizeof(uint64_t) +
+                       name_blob.size() + text_blob.size() + users.size() * sizeof(SnapUser) +
+                       games.size() * sizeof(SnapGame) + comments.size() * sizeof(SnapComment) +
+                       ids.size() * sizeof(uint32_t) + coplay_rows.size() * sizeof(SnapCoPlayRow) +
+                       coplay.size() * sizeof(CoPlayCount) + stats_rows.size() * sizeof(SnapGameStats) +
+                       stats.size() * sizeof(StatBucket);
+        std::string out(sizeof(SnapHeader), '\0');
+        out.reserve(total);
+        SnapHeader h{};
+        h.magic = SNAPSHOT_MAGIC;
+        h.version = SNAPSHOT_VERSION;
+        h.lsn = lsn;
+        h.names = append_strings(out, name_offsets, name_blob);
+        h.texts = append_strings(out, text_offsets, text_blob);
+        h.users = append(out, users);
+        h.games = append(out, games);
+        h.comments = append(out, comments);
+        h.ids = append(out, ids);
+        h.coplay_rows = append(out, coplay_rows);
+        h.coplay = append(out, coplay);
+        h.stats_rows = append(out, stats_rows);
+        h.stats = append(out, stats);
+        pad(out);
+        h.size = out.size();
+        h.crc = crc32c_update(0, out.data() + sizeof(SnapHeader), out.size() - sizeof(SnapHeader));
+        memcpy(&out[0], &h, sizeof(h));
+        return out;
+    }
+};
+
+// Read-only view of a snapshot held in memory or mapped from a file.
+class SnapshotReader {
+private:
+    const char* base = nullptr;
+    SnapHeader header{};
+    void* mapping = nullptr;
+    size_t mapped_size = 0;
+    std::unordered_map<uint32_t, uint32_t> stats_by_game;  // saved game name -> stats row
+
+    template <typename T>
+    const T* section(const SnapSection& s) const {
+        return (const T*)(base + s.offset);
+    }
+
+    bool fits(const SnapSection& s, size_t item_size, size_t extra_items = 0) const {
+        return s.offset % 8 == 0 && s.offset <= header.size &&
+               (s.count + extra_items) <= (header.size - s.offset) / item_size;
+    }
+
+    bool strings_fit(const SnapSection& s) const {
+        if (!fits(s, sizeof(uint64_t), 1)) return false;
+        const uint64_t* offsets = section<uint64_t>(s);
+        uint64_t blob = s.offset + (s.count + 1) * sizeof(uint64_t);
+        return offsets[s.count] <= header.size - blob;
+    }
+
+    std::string_view slice(const SnapSection& s, uint32_t i) const {
+        const uint64_t* offsets = section<uint64_t>(s);
+        const char* blob = (const char*)(offsets + s.count + 1);
+        return std::string_view(blob + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+    std::string name(uint32_t i) const { return std::string(slice(header.names, i)); }
+    std::string text(uint32_t i) const { return std::string(slice(header.texts, i)); }
+
+public:
+    SnapshotReader() = default;
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    ~SnapshotReader() {
+        if (mapping) munmap(mapping, mapped_size);
+    }
+
+    // Validates the header, section bounds and checksum of `size` bytes at `data`.
+    bool open(const char* data, size_t size) {
+        base = data;
+        header = SnapHeader{};
+        if (size < SNAPSHOT_V1_HEADER_SIZE) return false;
+        memcpy(&header, data, SNAPSHOT_V1_HEADER_SIZE);
+        if (header.magic != SNAPSHOT_MAGIC || header.size != size) return false;
+        size_t header_size;
+        if (header.version == SNAPSHOT_VERSION && size >= sizeof(SnapHeader)) {
+            memcpy(&header, data, sizeof(header));
+            header_size = sizeof(SnapHeader);
+        } else if (header.version == 1) {
+            header_size = SNAPSHOT_V1_HEADER_SIZE;
+        } else {
+            return false;
+        }
+        if (crc32c_update(0, data + header_size, size - header_size) != header.crc) return false;
+        if (!(strings_fit(header.names) && strings_fit(header.texts) &&
+              fits(header.users, sizeof(SnapUser)) && fits(header.games, sizeof(SnapGame)) &&
+              fits(header.comments, sizeof(SnapComment)) && fits(header.ids, sizeof(uint32_t)) &&
+              fits(header.coplay_rows, sizeof(SnapCoPlayRow)) && fits(header.coplay, sizeof(CoPlayCount)) &&
+              fits(header.stats_rows, sizeof(SnapGameStats)) && fits(header.stats, sizeof(StatBucket)))) {
+            return false;
+        }
+        const SnapGameStats* rows = section<SnapGameStats>(header.stats_rows);
+        for (uint32_t i = 0; i < header.stats_rows.count; i++) stats_by_game[rows[i].game] = i;
+        return true;
+    }
+
+    bool open_file(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        mapped_size = st.st_size;
+        mapping = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            return false;
+        }
+        madvise(mapping, mapped_size, MADV_SEQUENTIAL);
+        return open((const char*)mapping, mapped_size);
+    }
+
+    uint64_t lsn() const { return header.lsn; }
+    size_t user_count() const { return header.users.count; }
+    size_t game_count() const { return header.games.count; }
+
+    // Builds the typed records, co-play rows and analytics. `strings` gets every saved
+    // name; if it already held other strings the saved ids are translated to the
+    // ones it assigns.
+    void load(StringInterner& strings, std::vector<UserRecord>& out_users,
+              std::vector<GameRecord>& out_games, CoPlayIndex& out_coplay, GameAnalytics& out_stats) const {
+        std::vector<uint32_t> remap(header.names.count);
+        bool identity = true;
+        for (uint32_t i = 0; i < remap.size(); i++) {
+            remap[i] = strings.intern(slice(header.names, i));
+            identity = identity && remap[i] == i;
+        }
+        auto id = [&](uint32_t saved) { return identity ? saved : remap[saved]; };
+        const uint32_t* pool = section<uint32_t>(header.ids);
+
+        const SnapUser* users = section<SnapUser>(header.users);
+        out_users.reserve(out_users.size() + header.users.count);
+        for (size_t i = 0; i < header.users.count; i++) {
+            const SnapUser& r = users[i];
+            UserRecord u;
+            u.username = id(r.username);
+            u.role = id(r.role);
+            u.password = std::string(slice(header.texts, r.password));
+            for (uint32_t k = 0; k < r.history_count; k++) u.play_history.add(id(pool[r.history_offset + k]));
+            out_users.push_back(std::move(u));
+        }
+
+        const SnapGame* games = section<SnapGame>(header.games);
+        const SnapComment* comments = section<SnapComment>(header.comments);
+        out_games.reserve(out_games.size() + header.games.count);
+        for (size_t i = 0; i < header.games.count; i++) {
+            const SnapGame& r = games[i];
+            GameRecord g;
+            g.name = id(r.name);
+            g.dev = id(r.dev);
+            g.version = id(r.version);
+            g.game_type = id(r.game_type);
+            g.max_players = r.max_players;
+            g.downloads = r.downloads;
+            g.description = std::string(slice(header.texts, r.description));
+            g.filename = std::string(slice(header.texts, r.filename));
+
+            // Snapshots from before scores were validated may hold out-of-range
+            // ones; those are dropped and the score order is rebuilt.
+            std::vector<Comment> list;
+            list.reserve(r.comments_count);
+            for (uint32_t k = 0; k < r.comments_count; k++) {
+                const SnapComment& c = comments[r.comments_offset + k];
+                if (!RatingAggregate::valid(c.score)) continue;
+                list.push_back({id(c.user), c.score, std::string(slice(header.texts, c.content))});
+                g.rating.add(c.score);
+                g.commenters.add(list.back().user);
+            }
+            if (list.size() == r.comments_count) {
+                const uint32_t* order = pool + r.score_order_offset;
+                g.comments.assign(std::move(list), std::vector<uint32_t>(order, order + r.comments_count));
+            } else {
+                for (auto& c : list) g.comments.add(std::move(c));
+            }
+
+            for (uint32_t k = 0; k < r.downloaders_count; k++) g.downloaded_by.add(id(pool[r.downloaders_offset + k]));
+            g.play_trend = r.play_trend;
+            out_games.push_back(std::move(g));
+        }
+
+        const SnapCoPlayRow* rows = section<SnapCoPlayRow>(header.coplay_rows);
+        const CoPlayCount* counts = section<CoPlayCount>(header.coplay);
+        for (size_t i = 0; i < header.coplay_rows.count; i++) {
+            const CoPlayCount* row = counts + rows[i].offset;
+            std::vector<CoPlayCount> list(row, row + rows[i].count);
+            if (!identity) {
+                for (auto& c : list) c.game = remap[c.game];
+                std::sort(list.begin(), list.end(), [](const CoPlayCount& a, const CoPlayCount& b) { return a.game < b.game; });
+            }
+            out_coplay.set_row(id(rows[i].game), std::move(list));
+        }
+
+        const SnapGameStats* stat_rows = section<SnapGameStats>(header.stats_rows);
+        const StatBucket* buckets = section<StatBucket>(header.stats);
+        for (size_t i = 0; i < header.stats_rows.count; i++) {
+            const SnapGameStats& r = stat_rows[i];
+            for (uint32_t k = 0; k < r.hours + r.days; k++) out_stats.restore(id(r.game), buckets[r.offset + k], k >= r.hours);
+        }
+    }
+
+    // One users[] entry of the database.json document.
+    json user_json(size_t i) const {
+        const uint32_t* pool = section<uint32_t>(header.ids);
+        const SnapUser& r = section<SnapUser>(header.users)[i];
+        json u = {{"username", name(r.username)}, {"password", text(r.password)}, {"role", name(r.role)}};
+        if (r.history_count > 0) {
+            json history = json::array();
+            for (uint32_t k = 0; k < r.history_count; k++) history.push_back(name(pool[r.history_offset + k]));
+            u["play_history"] = history;
+        }
+        return u;
+    }
+
+    // A game's analytics in GameAnalytics::to_json() form.
+    json stats_json(uint32_t row) const {
+        const SnapGameStats& r = section<SnapGameStats>(header.stats_rows)[row];
+        const StatBucket* buckets = section<StatBucket>(header.stats) + r.offset;
+        json out = {{"hours", json::array()}, {"days", json::array()}};
+        for (uint32_t k = 0; k < r.hours + r.days; k++) {
+            json bucket = {buckets[k].index};
+            for (uint32_t c : buckets[k].counts) bucket.push_back(c);
+            out[k < r.hours ? "hours" : "days"].push_back(bucket);
+        }
+        return out;
+    }
+
+    // One games[] entry of the database.json document.
+    json game_json(size_t i) const {
+        const uint32_t* pool = section<uint32_t>(header.ids);
+        const SnapGame& r = section<SnapGame>(header.games)[i];
+        const SnapComment* comments = section<SnapComment>(header.comments);
+        json list = json::array();
+        for (uint32_t k = 0; k < r.comments_count; k++) {
+            const SnapComment& c = comments[r.comments_offset + k];
+            list.push_back({{"user", name(c.user)}, {"score", c.score}, {"content", text(c.content)}});
+        }
+        json downloaded_by = json::array();
+        for (uint32_t k = 0; k < r.downloaders_count; k++) downloaded_by.push_back(name(pool[r.downloaders_offset + k]));
+
+        json g = {
+            {"name", name(r.name)},
+            {"dev", name(r.dev)},
+            {"description", text(r.description)},
+            {"filename", text(r.filename)},
+            {"version", name(r.version)},
+            {"game_type", name(r.game_type)},
+            {"max_players", r.max_players},
+            {"comments", list},
+            {"downloaded_by", downloaded_by}
+        };
+        if (r.downloads > 0) g["downloads"] = r.downloads;
+        if (std::isfinite(r.play_trend)) g["play_trend"] = r.play_trend;
+        auto stats = stats_by_game.find(r.name);
+        if (stats != stats_by_game.end()) g["stats"] = stats_json(stats->second);
+        return g;
+    }
+
+    // The same state as a database.json document.
+    json to_json() const {
+        json doc;
+        doc["users"] = json::array();
+        for (size_t i = 0; i < header.users.count; i++) doc["users"].push_back(user_json(i));
+        doc["games"] = json::array();
+        for (size_t i = 0; i < header.games.count; i++) doc["games"].push_back(game_json(i));
+        doc["lsn"] = header.lsn;
+        return doc;
+    }
+
+    // Writes to_json().dump(4) one record at a time, so neither the document
+    // nor its text is ever held whole.
+    void write_json(std::ostream& out) const {
+        auto write_list = [&](const char* key, size_t count, auto&& entry) {
+            out << "    \"" << key << "\": ";
+            if (count == 0) {
+                out << "[]";
+                return;
+            }
+            out << "[\n";
+            for (size_t i = 0; i < count; i++) {
+                std::string dumped = entry(i).dump(4);
+                out << "        ";
+                size_t from = 0;
+                for (size_t nl; (nl = dumped.find('\n', from)) != std::string::npos; from = nl + 1) {
+                    out.write(dumped.data() + from, nl + 1 - from);
+                    out << "        ";
+                }
+                out.write(dumped.data() + from, dumped.size() - from);
+                out << (i + 1 < count ? ",\n" : "\n");
+            }
+            out << "    ]";
+        };
+        // Keys in json's (sorted) order.
+        out << "{\n";
+        write_list("games", header.games.count, [&](size_t i) { return game_json(i); });
+        out << ",\n    \"lsn\": " << header.lsn << ",\n";
+        write_list("users", header.users.count, [&](size_t i) { return user_json(i); });
+        out << "\n}";
+    }
+};
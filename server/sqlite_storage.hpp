@@ -0,0 +1,443 @@
+#pragma once
+#include "storage.hpp"
+#include <sqlite3.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Embedded SQLite engine: an alternative durable home for the same in-memory
+// Database, not a larger-than-RAM store. load() reads every table into the
+// working set, and reads are served from memory as with the JSON engine.
+// Mutation records are written to normalized tables by a writer thread that
+// commits each batch as one transaction (journal_mode=WAL, synchronous=FULL:
+// one fsync per batch). A batch that fails is rolled back and retried, never
+// reported durable.
+class SqliteStorage : public StorageEngine {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    sqlite3* conn = nullptr;
+    std::string path;
+    std::unordered_map<std::string, sqlite3_stmt*> stmts;
+
+    std::chrono::microseconds window;
+    size_t max_batch;
+    bool debounce;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::condition_variable durable_cv;
+    std::vector<json> pending;
+    uint64_t pending_lsn = 0;
+    uint64_t durable_lsn = 0;
+    Clock::time_point first_pending;
+    size_t waiters = 0;
+    bool stopping = false;
+    bool running = false;
+    std::thread writer;
+
+    std::atomic<uint64_t> records{0};
+    std::atomic<uint64_t> transactions{0};
+    std::atomic<uint64_t> write_failures{0};
+    std::atomic<bool> failing{false};
+
+    bool exec(const char* sql) {
+        char* err = nullptr;
+        if (sqlite3_exec(conn, sql, nullptr, nullptr, &err) != SQLITE_OK) {
+            std::cerr << "Error: sqlite: " << (err ? err : "?") << " in: " << sql << std::endl;
+            sqlite3_free(err);
+            return false;
+        }
+        return true;
+    }
+
+    sqlite3_stmt* stmt(const std::string& key, const char* sql) {
+        auto it = stmts.find(key);
+        if (it != stmts.end()) {
+            sqlite3_reset(it->second);
+            sqlite3_clear_bindings(it->second);
+            return it->second;
+        }
+        sqlite3_stmt* s = nullptr;
+        if (sqlite3_prepare_v2(conn, sql, -1, &s, nullptr) != SQLITE_OK) {
+            std::cerr << "Error: sqlite prepare: " << sqlite3_errmsg(conn) << std::endl;
+            return nullptr;
+        }
+        stmts[key] = s;
+        return s;
+    }
+
+    static void bind(sqlite3_stmt* s, int idx, const std::string& v) {
+        sqlite3_bind_text(s, idx, v.data(), (int)v.size(), SQLITE_TRANSIENT);
+    }
+
+    static void bind(sqlite3_stmt* s, int idx, int64_t v) {
+        sqlite3_bind_int64(s, idx, v);
+    }
+
+    static void bind(sqlite3_stmt* s, int idx, double v) {
+        sqlite3_bind_double(s, idx, v);
+    }
+
+    template <typename... Args>
+    bool run(const std::string& key, const char* sql, const Args&... args) {
+        sqlite3_stmt* s = stmt(key, sql);
+        if (!s) return false;
+        int idx = 1;
+        (bind(s, idx++, args), ...);
+        int rc = sqlite3_step(s);
+        if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
+            std::cerr << "Error: sqlite " << key << ": " << sqlite3_errmsg(conn) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    static std::string column_text(sqlite3_stmt* s, int col) {
+        const unsigned char* t = sqlite3_column_text(s, col);
+        return t ? std::string((const char*)t, sqlite3_column_bytes(s, col)) : std::string();
+    }
+
+    bool create_schema() {
+        return exec(
+            "CREATE TABLE IF NOT EXISTS meta (key TEXT PRIMARY KEY, value INTEGER NOT NULL);"
+            "CREATE TABLE IF NOT EXISTS users ("
+            "  username TEXT PRIMARY KEY, password TEXT NOT NULL, role TEXT NOT NULL);"
+            "CREATE TABLE IF NOT EXISTS games ("
+            "  name TEXT PRIMARY KEY, dev TEXT NOT NULL, description TEXT, filename TEXT,"
+            "  version TEXT, game_type TEXT, max_players INTEGER, downloads INTEGER NOT NULL DEFAULT 0);"
+            "CREATE INDEX IF NOT EXISTS games_by_dev ON games(dev);"
+            "CREATE TABLE IF NOT EXISTS comments ("
+            "  id INTEGER PRIMARY KEY, game TEXT NOT NULL, user TEXT NOT NULL,"
+            "  score INTEGER NOT NULL, content TEXT, UNIQUE(game, user));"
+            "CREATE TABLE IF NOT EXISTS downloads ("
+            "  id INTEGER PRIMARY KEY, game TEXT NOT NULL, user TEXT NOT NULL, UNIQUE(game, user));"
+            "CREATE TABLE IF NOT EXISTS plays ("
+            "  id INTEGER PRIMARY KEY, user TEXT NOT NULL, game TEXT NOT NULL, UNIQUE(user, game));"
+            "CREATE TABLE IF NOT EXISTS game_trends (game TEXT PRIMARY KEY, trend REAL NOT NULL);"
+            "CREATE TABLE IF NOT EXISTS game_stats (game TEXT PRIMARY KEY, series TEXT NOT NULL);"
+            "INSERT OR IGNORE INTO meta VALUES ('lsn', 0);");
+    }
+
+    // Mirrors Database::apply(); records that are no-ops in memory are no-ops here.
+    bool write_record(const json& rec) {
+        std::string op = rec["op"];
+
+        if (op == "register_user") {
+            return run("register_user", "INSERT OR IGNORE INTO users VALUES (?, ?, ?)",
+                       rec["username"].get<std::string>(), rec["password"].get<std::string>(),
+                       rec["role"].get<std::string>());
+        }
+        if (op == "upsert_game") {
+            return run("upsert_game",
+                       "INSERT INTO games (name, dev, description, filename, version, game_type, max_players)"
+                       " VALUES (?, ?, ?, ?, ?, ?, ?)"
+                       " ON CONFLICT(name) DO UPDATE SET description = excluded.description,"
+                       " filename = excluded.filename, version = excluded.version,"
+                       " game_type = excluded.game_type, max_players = excluded.max_players"
+                       " WHERE games.dev = excluded.dev",
+                       rec["name"].get<std::string>(), rec["dev"].get<std::string>(),
+                       rec["description"].get<std::string>(), rec["filename"].get<std::string>(),
+                       rec["version"].get<std::string>(), rec["game_type"].get<std::string>(),
+                       (int64_t)rec["max_players"].get<int>());
+        }
+        if (op == "delete_game") {
+            std::string name = rec["name"];
+            if (!run("delete_game", "DELETE FROM games WHERE name = ? AND dev = ?",
+                     name, rec["dev"].get<std::string>())) return false;
+            if (sqlite3_changes(conn) == 0) return true;
+            return run("delete_comments", "DELETE FROM comments WHERE game = ?", name) &&
+                   run("delete_downloads", "DELETE FROM downloads WHERE game = ?", name) &&
+                   run("delete_trend", "DELETE FROM game_trends WHERE game = ?", name) &&
+                   run("delete_stats", "DELETE FROM game_stats WHERE game = ?", name);
+        }
+        if (op == "add_comment") {
+            return run("add_comment",
+                       "INSERT OR IGNORE INTO comments (game, user, score, content)"
+                       " SELECT ?1, ?2, ?3, ?4 WHERE EXISTS (SELECT 1 FROM games WHERE name = ?1)",
+                       rec["game"].get<std::string>(), rec["user"].get<std::string>(),
+                       (int64_t)rec["score"].get<int>(), rec["content"].get<std::string>());
+        }
+        if (op == "record_download") {
+            return run("record_download",
+                       "INSERT OR IGNORE INTO downloads (game, user)"
+                       " SELECT ?1, ?2 WHERE EXISTS (SELECT 1 FROM games WHERE name = ?1)",
+                       rec["game"].get<std::string>(), rec["user"].get<std::string>());
+        }
+        if (op == "record_play") {
+            return run("record_play",
+                       "INSERT OR IGNORE INTO plays (user, game)"
+                       " SELECT ?1, ?2 WHERE EXISTS (SELECT 1 FROM users WHERE username = ?1)",
+                       rec["user"].get<std::string>(), rec["game"].get<std::string>());
+        }
+        if (op == "record_plays") {
+            return run("record_plays",
+                       "INSERT INTO game_trends (game, trend)"
+                       " SELECT ?1, ?2 WHERE EXISTS (SELECT 1 FROM games WHERE name = ?1)"
+                       " ON CONFLICT(game) DO UPDATE SET trend = excluded.trend",
+                       rec["game"].get<std::string>(), rec["trend"].get<double>());
+        }
+        if (op == "game_stats") {
+            // Each record carries the game's whole series, so the newest wins.
+            return run("game_stats",
+                       "INSERT INTO game_stats (game, series)"
+                       " SELECT ?1, ?2 WHERE EXISTS (SELECT 1 FROM games WHERE name = ?1)"
+                       " ON CONFLICT(game) DO UPDATE SET series = excluded.series",
+                       rec["game"].get<std::string>(), rec["stats"].dump());
+        }
+        if (op == "increment_downloads") {
+            return run("increment_downloads", "UPDATE games SET downloads = downloads + 1 WHERE name = ?",
+                       rec["game"].get<std::string>());
+        }
+        return true;
+    }
+
+    // All or nothing: if any record fails the whole batch, meta.lsn included,
+    // is rolled back.
+    bool write_batch(const std::vector<json>& batch, uint64_t batch_lsn) {
+        if (!exec("BEGIN IMMEDIATE")) return false;
+        bool ok = true;
+        for (const auto& rec : batch) {
+            if (!write_record(rec)) {
+                ok = false;
+                break;
+            }
+        }
+        ok = ok && run("set_lsn", "UPDATE meta SET value = ? WHERE key = 'lsn'", (int64_t)batch_lsn);
+        if (!ok || !exec("COMMIT")) {
+            exec("ROLLBACK");
+            return false;
+        }
+        transactions++;
+        return true;
+    }
+
+    void writer_loop() {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        while (true) {
+            queue_cv.wait(lock, [this] { return !pending.empty() || stopping; });
+            if (pending.empty() && stopping) break;
+
+            // As in WriteAheadLog: a lone committer is written at once.
+            if (debounce || waiters > 1) {
+                queue_cv.wait_until(lock, first_pending + window, [this] {
+                    return pending.size() >= max_batch || stopping;
+                });
+            }
+
+            std::vector<json> batch;
+            batch.swap(pending);
+            uint64_t batch_lsn = pending_lsn;
+            lock.unlock();
+
+            // Retried until it commits, so later batches never skip past it;
+            // on shutdown the engine gives up instead.
+            auto backoff = std::chrono::milliseconds(10);
+            bool written;
+            while (!(written = write_batch(batch, batch_lsn))) {
+                write_failures++;
+                failing = true;
+                std::cerr << "Error: SQLite write failed for batch ending at LSN " << batch_lsn
+                          << ", retrying in " << backoff.count() << " ms" << std::endl;
+                lock.lock();
+                bool stop = queue_cv.wait_for(lock, backoff, [this] { return stopping; });
+                lock.unlock();
+                if (stop) break;
+                backoff = std::min(backoff * 2, std::chrono::milliseconds(1000));
+            }
+
+            lock.lock();
+            if (!written) {
+                std::cerr << "Error: SQLite abandoned unwritten records from LSN " << durable_lsn + 1 << std::endl;
+                break;
+            }
+            failing = false;
+            durable_lsn = batch_lsn;
+            durable_cv.notify_all();
+        }
+        running = false;
+        durable_cv.notify_all();
+    }
+
+public:
+    // With `always_wait` every batch waits out `batch_window` (async durability).
+    SqliteStorage(const std::string& db_path, std::chrono::microseconds batch_window, size_t batch_records,
+                  bool always_wait)
+        : path(db_path), window(batch_window), max_batch(std::max<size_t>(1, batch_records)),
+          debounce(always_wait) {
+        if (sqlite3_open(path.c_str(), &conn) != SQLITE_OK) {
+            std::cerr << "Error: cannot open " << path << ": " << sqlite3_errmsg(conn) << std::endl;
+            return;
+        }
+        exec("PRAGMA journal_mode=WAL");
+        exec("PRAGMA synchronous=FULL");
+        exec("PRAGMA foreign_keys=OFF");
+        create_schema();
+    }
+
+    ~SqliteStorage() override {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+        }
+        queue_cv.notify_all();
+        if (writer.joinable()) writer.join();
+        for (auto& [key, s] : stmts) sqlite3_finalize(s);
+        if (conn) sqlite3_close(conn);
+    }
+
+    const char* name() const override { return "sqlite"; }
+
+    bool ok() const { return conn != nullptr; }
+
+    uint64_t load(StorageSink& sink) override {
+        uint64_t last_lsn = 0;
+        sqlite3_stmt* s = stmt("load_lsn", "SELECT value FROM meta WHERE key = 'lsn'");
+        if (s && sqlite3_step(s) == SQLITE_ROW) last_lsn = sqlite3_column_int64(s, 0);
+
+        std::unordered_map<std::string, json> history;
+        s = stmt("load_plays", "SELECT user, game FROM plays ORDER BY id");
+        while (s && sqlite3_step(s) == SQLITE_ROW) {
+            history[column_text(s, 0)].push_back(column_text(s, 1));
+        }
+        s = stmt("load_users", "SELECT username, password, role FROM users ORDER BY rowid");
+        while (s && sqlite3_step(s) == SQLITE_ROW) {
+            json u = {{"username", column_text(s, 0)}, {"password", column_text(s, 1)}, {"role", column_text(s, 2)}};
+            auto it = history.find(u["username"]);
+            if (it != history.end()) u["play_history"] = it->second;
+            sink.user(u);
+        }
+        history.clear();
+
+        std::unordered_map<std::string, json> comments, downloaders;
+        std::unordered_map<std::string, double> trends;
+        std::unordered_map<std::string, std::string> stats;
+        s = stmt("load_comments", "SELECT game, user, score, content FROM comments ORDER BY id");
+        while (s && sqlite3_step(s) == SQLITE_ROW) {
+            comments[column_text(s, 0)].push_back({
+                {"user", column_text(s, 1)},
+                {"score", sqlite3_column_int(s, 2)},
+                {"content", column_text(s, 3)}
+            });
+        }
+        s = stmt("load_downloads", "SELECT game, user FROM downloads ORDER BY id");
+        while (s && sqlite3_step(s) == SQLITE_ROW) {
+            downloaders[column_text(s, 0)].push_back(column_text(s, 1));
+        }
+        s = stmt("load_trends", "SELECT game, trend FROM game_trends");
+        while (s && sqlite3_step(s) == SQLITE_ROW) {
+            trends[column_text(s, 0)] = sqlite3_column_double(s, 1);
+        }
+        s = stmt("load_stats", "SELECT game, series FROM game_stats");
+        while (s && sqlite3_step(s) == SQLITE_ROW) {
+            stats[column_text(s, 0)] = column_text(s, 1);
+        }
+        s = stmt("load_games", "SELECT name, dev, description, filename, version, game_type, max_players, downloads"
+                               " FROM games ORDER BY rowid");
+        while (s && sqlite3_step(s) == SQLITE_ROW) {
+            std::string name = column_text(s, 0);
+            json g = {
+                {"name", name},
+                {"dev", column_text(s, 1)},
+                {"description", column_text(s, 2)},
+                {"filename", column_text(s, 3)},
+                {"version", column_text(s, 4)},
+                {"game_type", column_text(s, 5)},
+                {"max_players", sqlite3_column_int(s, 6)},
+                {"downloads", sqlite3_column_int(s, 7)},
+                {"comments", comments.count(name) ? comments[name] : json::array()},
+                {"downloaded_by", downloaders.count(name) ? downloaders[name] : json::array()}
+            };
+            if (trends.count(name)) g["play_trend"] = trends[name];
+            if (stats.count(name)) g["stats"] = json::parse(stats[name], nullptr, false);
+            sink.game(g);
+        }
+
+        durable_lsn = pending_lsn = last_lsn;
+        running = true;
+        writer = std::thread(&SqliteStorage::writer_loop, this);
+        return last_lsn;
+    }
+
+    // Bulk-loads a database.json-shaped snapshot into empty tables.
+    bool import_snapshot(const json& snapshot) {
+        if (!exec("BEGIN IMMEDIATE")) return false;
+        bool ok = true;
+        for (const auto& u : snapshot.value("users", json::array())) {
+            ok = run("register_user", "INSERT OR IGNORE INTO users VALUES (?, ?, ?)",
+                     u.value("username", ""), u.value("password", ""), u.value("role", "")) && ok;
+            for (const auto& g : u.value("play_history", json::array())) {
+                ok = run("import_play", "INSERT OR IGNORE INTO plays (user, game) VALUES (?, ?)",
+                         u.value("username", ""), g.get<std::string>()) && ok;
+            }
+        }
+        for (const auto& g : snapshot.value("games", json::array())) {
+            std::string name = g.value("name", "");
+            ok = run("import_game",
+                     "INSERT OR IGNORE INTO games VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+                     name, g.value("dev", ""), g.value("description", ""), g.value("filename", ""),
+                     g.value("version", ""), g.value("game_type", ""),
+                     (int64_t)g.value("max_players", 2), (int64_t)g.value("downloads", 0)) && ok;
+            for (const auto& c : g.value("comments", json::array())) {
+                ok = run("import_comment", "INSERT OR IGNORE INTO comments (game, user, score, content) VALUES (?, ?, ?, ?)",
+                         name, c.value("user", ""), (int64_t)c.value("score", 0), c.value("content", "")) && ok;
+            }
+            for (const auto& u : g.value("downloaded_by", json::array())) {
+                ok = run("import_download", "INSERT OR IGNORE INTO downloads (game, user) VALUES (?, ?)",
+                         name, u.get<std::string>()) && ok;
+            }
+            if (g.contains("play_trend")) {
+                ok = run("import_trend", "INSERT OR REPLACE INTO game_trends VALUES (?, ?)",
+                         name, g["play_trend"].get<double>()) && ok;
+            }
+            if (g.contains("stats")) {
+                ok = run("import_stats", "INSERT OR REPLACE INTO game_stats VALUES (?, ?)",
+                         name, g["stats"].dump()) && ok;
+            }
+        }
+        ok = run("set_lsn", "UPDATE meta SET value = ? WHERE key = 'lsn'",
+                 (int64_t)snapshot.value("lsn", (uint64_t)0)) && ok;
+        if (!ok || !exec("COMMIT")) {
+            exec("ROLLBACK");
+            return false;
+        }
+        return true;
+    }
+
+    void append(uint64_t lsn, const json& rec) override {
+        records++;
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (pending.empty()) first_pending = Clock::now();
+        pending.push_back(rec);
+        pending_lsn = lsn;
+        if (pending.size() == 1 || pending.size() >= max_batch) queue_cv.notify_one();
+    }
+
+    bool wait_durable(uint64_t lsn) override {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        waiters++;
+        durable_cv.wait(lock, [&] { return durable_lsn >= lsn || !running; });
+        waiters--;
+        return durable_lsn >= lsn;
+    }
+
+    json stats() override {
+        uint64_t r = records, t = transactions;
+        json s;
+        s["engine"] = name();
+        s["path"] = path;
+        s["records"] = r;
+        s["transactions"] = t;
+        s["records_per_transaction"] = t ? (double)r / t : 0.0;
+        s["write_failures"] = write_failures.load();
+        s["failing"] = failing.load();
+        s["window_us"] = window.count();
+        s["max_batch"] = max_batch;
+        return s;
+    }
+};
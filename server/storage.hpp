@@ -0,0 +1,206 @@
+#pragma once
+#include "../json.hpp"
+#include "json_snapshot.hpp"
+#include "snapshot.hpp"
+#include "wal.hpp"
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+
+#define WAL_COMPACT_BYTES (4 * 1024 * 1024)
+
+using json = nlohmann::json;
+
+// Receives persisted state during StorageEngine::load(): a binary snapshot, a
+// streaming database.json loader, or whole user and game documents (snapshot
+// shape) first, then any newer mutation records.
+struct StorageSink {
+    std::function<void(const SnapshotReader&)> snapshot;
+    std::function<void(JsonSnapshotLoader&)> json_snapshot;
+    std::function<void(const json&)> user;
+    std::function<void(const json&)> game;
+    std::function<void(const json&)> record;
+};
+
+// Durable home of the Database. The Database keeps the working set in memory
+// and hands every mutation record (carrying its "lsn") to the engine in LSN order.
+class StorageEngine {
+public:
+    virtual ~StorageEngine() = default;
+
+    virtual const char* name() const = 0;
+
+    // Replays persisted state into `sink` and returns the last LSN it contained.
+    virtual uint64_t load(StorageSink& sink) = 0;
+
+    virtual void append(uint64_t lsn, const json& rec) = 0;
+    // False if the engine stopped before `lsn` was durable.
+    virtual bool wait_durable(uint64_t lsn) = 0;
+
+    // Checkpointing folds appended records into a full snapshot. begin runs with
+    // the Database quiesced; finish runs afterwards with the binary snapshot
+    // (SnapshotWriter output) it produced.
+    virtual bool needs_checkpoint() const { return false; }
+    virtual bool begin_checkpoint() { return true; }
+    virtual bool finish_checkpoint(const std::string& image) { return true; }
+
+    virtual json stats() = 0;
+};
+
+// Snapshot file plus the JSON-lines write-ahead log. The snapshot is either
+// binary (database.snap, mapped at startup) or database.json. Whenever
+// database.snap exists it is the current one: binary checkpoints write it next
+// to database.json, which is never deleted and stays as it was, and JSON
+// checkpoints rewrite database.json and then remove database.snap. A format
+// switch converts the data on the first checkpoint, which startup requests
+// right away.
+class JsonStorage : public StorageEngine {
+private:
+    std::string db_file;
+    std::string snap_file;
+    std::string wal_file;
+    std::string wal_old_file;
+    bool binary;
+    bool read_only;
+    std::atomic<bool> convert_pending{false};
+    WriteAheadLog wal;
+
+    bool write_snapshot(const std::string& path, const std::function<void(std::ostream&)>& write) {
+        std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream out(tmp_path, std::ios::trunc | std::ios::binary);
+            write(out);
+            out.flush();
+            if (!out.good()) return false;
+        }
+
+        int fd = ::open(tmp_path.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            fsync(fd);
+            ::close(fd);
+        }
+        if (rename(tmp_path.c_str(), path.c_str()) != 0) return false;
+
+        int dir_fd = ::open(".", O_RDONLY);
+        if (dir_fd >= 0) {
+            fsync(dir_fd);
+            ::close(dir_fd);
+        }
+        return true;
+    }
+
+    // Streams database.json into the sink; a missing file is an empty database.
+    uint64_t load_json(StorageSink& sink) {
+        JsonSnapshotLoader loader;
+        if (!loader.open(db_file)) return 0;
+        sink.json_snapshot(loader);
+        if (!loader.ok()) {
+            std::cerr << "Warning: DB file corrupted or empty, initializing new." << std::endl;
+        }
+        return loader.lsn();
+    }
+
+public:
+    // `snapshot_format` is "binary" or "json". With `debounce` every WAL batch
+    // waits out `window` (async durability). A `read_only` engine loads
+    // whichever snapshot is current plus the logs and never writes: no WAL is
+    // opened, torn tails are left alone and no checkpoint is requested.
+    JsonStorage(const std::string& path, const std::string& snapshot_format,
+                std::chrono::microseconds window, size_t max_batch, bool debounce, bool read_only)
+        : db_file(path), snap_file(path.substr(0, path.rfind('.')) + ".snap"),
+          wal_file(path.substr(0, path.rfind('.')) + ".wal"), wal_old_file(wal_file + ".old"),
+          binary(snapshot_format == "binary"), read_only(read_only) {
+        wal.configure(window, max_batch, debounce);
+    }
+
+    const char* name() const override { return "json"; }
+
+    uint64_t load(StorageSink& sink) override {
+        bool have_snap = access(snap_file.c_str(), F_OK) == 0;
+        bool have_json = access(db_file.c_str(), F_OK) == 0;
+        uint64_t last_lsn = 0;
+        if (have_snap) {
+            SnapshotReader reader;
+            if (!reader.open_file(snap_file)) {
+                std::cerr << "Error: " << snap_file << " is unreadable or corrupted." << std::endl;
+                exit(1);
+            }
+            sink.snapshot(reader);
+            last_lsn = reader.lsn();
+            convert_pending = !binary;
+        } else {
+            last_lsn = load_json(sink);
+            convert_pending = binary && have_json;
+        }
+
+        size_t replayed = 0;
+        auto replay_one = [&](const json& rec) {
+            uint64_t lsn = rec.value("lsn", (uint64_t)0);
+            if (lsn <= last_lsn) return;
+            sink.record(rec);
+            last_lsn = lsn;
+            replayed++;
+        };
+        WriteAheadLog::replay(wal_old_file, replay_one, !read_only);
+        WriteAheadLog::replay(wal_file, replay_one, !read_only);
+        if (replayed > 0) {
+            std::cout << "[DB] Recovered " << replayed << " mutations from the write-ahead log." << std::endl;
+        }
+
+        if (read_only) {
+            convert_pending = false;
+        } else {
+            wal.open(wal_file, last_lsn);
+        }
+        return last_lsn;
+    }
+
+    void append(uint64_t lsn, const json& rec) override {
+        wal.enqueue(lsn, rec);
+    }
+
+    bool wait_durable(uint64_t lsn) override {
+        return wal.wait_durable(lsn);
+    }
+
+    bool needs_checkpoint() const override {
+        return convert_pending || wal.size_bytes() >= WAL_COMPACT_BYTES;
+    }
+
+    bool begin_checkpoint() override {
+        if (!wal.rotate(wal_old_file)) {
+            std::cerr << "Error: WAL rotation failed, compaction skipped." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool finish_checkpoint(const std::string& image) override {
+        bool ok;
+        if (binary) {
+            ok = write_snapshot(snap_file, [&](std::ostream& out) { out.write(image.data(), image.size()); });
+        } else {
+            SnapshotReader reader;
+            ok = reader.open(image.data(), image.size()) &&
+                 write_snapshot(db_file, [&](std::ostream& out) { reader.write_json(out); });
+        }
+        if (!ok) {
+            std::cerr << "Error: snapshot write failed, keeping " << wal_old_file << std::endl;
+            return false;
+        }
+        if (!binary) remove(snap_file.c_str());
+        remove(wal_old_file.c_str());
+        convert_pending = false;
+        return true;
+    }
+
+    json stats() override {
+        json s;
+        s["engine"] = name();
+        s["snapshot"] = binary ? "binary" : "json";
+        s["wal"] = wal.stats();
+        return s;
+    }
+};
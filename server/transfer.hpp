@@ -0,0 +1,396 @@
+#pragma once
+#include "../basic.hpp"
+#include "file_cache.hpp"
+#include "transfer_scheduler.hpp"
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <functional>
+#include <netinet/ip.h>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define TRANSFER_ACCEPT_TIMEOUT_SEC 10
+#define TRANSFER_IDLE_TIMEOUT_SEC   30
+#define TRANSFER_IO_SLICE           (64 * 1024)
+
+#ifdef MSG_NOSIGNAL
+    #define TRANSFER_SEND_FLAGS MSG_NOSIGNAL
+#else
+    #define TRANSFER_SEND_FLAGS 0
+#endif
+
+using TransferClock = std::chrono::steady_clock;
+
+struct UploadTransfer {
+    TransferScheduler& sched;
+    std::string filepath;
+    std::string part_path;
+    size_t filesize;
+    int flow;
+    int part_fd = -1;
+    bool completed = false;
+    // Block checksums of the received bytes, handed to on_finish so the
+    // file never has to be read again to checksum it.
+    FileChecksums checksums;
+    bool has_expected_crc = false;
+    uint32_t expected_crc = 0;
+    std::function<void(bool ok, const FileChecksums& checksums)> on_finish;
+
+    UploadTransfer(TransferScheduler& s, std::string path, size_t size, const std::string& user,
+                   std::function<void(bool, const FileChecksums&)> done)
+        : sched(s), filepath(path), part_path(path + ".part"), filesize(size),
+          flow(s.open_flow(user, TransferClass::UPLOAD)), on_finish(std::move(done)) {}
+
+    void verify() {
+        checksums.finish();
+        completed = !has_expected_crc || checksums.whole == expected_crc;
+        if (!completed) {
+            std::cerr << "[Error] Upload checksum mismatch: " << filepath << std::endl;
+        }
+    }
+
+    ~UploadTransfer() {
+        if (part_fd >= 0) ::close(part_fd);
+        sched.close_flow(flow);
+        if (!completed) {
+            remove(part_path.c_str());
+            std::cerr << "[Error] Upload incomplete: " << filepath << std::endl;
+        }
+        if (on_finish) on_finish(completed, checksums);
+    }
+};
+
+struct DownloadTransfer {
+    TransferScheduler& sched;
+    std::shared_ptr<const MappedFile> blob;
+    std::string filepath;
+    int streams;
+    size_t chunk_size;
+    int flow;
+    int served = 0;
+
+    DownloadTransfer(TransferScheduler& s, std::shared_ptr<const MappedFile> b, std::string path,
+                     int n_streams, size_t chunk, const std::string& user, TransferClass cls)
+        : sched(s), blob(std::move(b)), filepath(path), streams(n_streams), chunk_size(chunk),
+          flow(s.open_flow(user, cls)) {}
+
+    ~DownloadTransfer() {
+        sched.close_flow(flow);
+        std::cout << "[System] File sent: " << filepath << " (" << served << "/" << streams << " streams)" << std::endl;
+    }
+};
+
+// One non-blocking transfer endpoint: a listening socket waiting for data
+// connections, or a data connection moving bytes for an upload or download.
+struct TransferSession {
+    enum class State { ACCEPTING, READ_INDEX, STREAMING };
+
+    int fd = -1;
+    State state = State::ACCEPTING;
+    std::shared_ptr<UploadTransfer> upload;
+    std::shared_ptr<DownloadTransfer> download;
+
+    int accepts_left = 0;
+    uint32_t net_idx = 0;
+    size_t idx_have = 0;
+    size_t offset = 0;
+    size_t remaining = 0;
+
+    TransferClock::time_point deadline;
+    TransferClock::time_point wake_at;
+};
+
+// Drives many transfer sessions from one thread with poll(), so concurrent
+// transfers cost a socket and a few hundred bytes of state instead of a thread.
+class TransferReactor {
+private:
+    TransferScheduler& sched;
+    int wake_pipe[2];
+    std::thread worker;
+
+    std::mutex inbox_mutex;
+    std::vector<TransferSession> inbox;
+    std::vector<TransferSession> sessions;
+
+    std::atomic<size_t> active{0};
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> failed{0};
+
+    static void set_nonblocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    static bool would_block() {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+
+    enum class Step { KEEP, DONE, FAIL };
+
+    void add_data_session(const TransferSession& listener, int data_fd, TransferClock::time_point now,
+                          std::vector<TransferSession>& out) {
+        set_nonblocking(data_fd);
+        int tos = IPTOS_THROUGHPUT;
+        setsockopt(data_fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+
+        TransferSession s;
+        s.fd = data_fd;
+        s.upload = listener.upload;
+        s.download = listener.download;
+        s.deadline = now + std::chrono::seconds(TRANSFER_IDLE_TIMEOUT_SEC);
+        s.wake_at = now;
+
+        if (s.upload) {
+            s.upload->part_fd = ::open(s.upload->part_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (s.upload->part_fd < 0) {
+                ::close(data_fd);
+                return;
+            }
+            s.state = TransferSession::State::STREAMING;
+            s.remaining = s.upload->filesize;
+        } else {
+            s.download->served++;
+            if (s.download->streams > 1) {
+                s.state = TransferSession::State::READ_INDEX;
+            } else {
+                s.state = TransferSession::State::STREAMING;
+                s.remaining = s.download->blob->size;
+            }
+        }
+        out.push_back(std::move(s));
+    }
+
+    Step on_accept(TransferSession& s, std::vector<TransferSession>& born, TransferClock::time_point now) {
+        while (s.accepts_left > 0) {
+            int data_fd = accept(s.fd, NULL, NULL);
+            if (data_fd < 0) return would_block() ? Step::KEEP : Step::FAIL;
+            s.accepts_left--;
+            add_data_session(s, data_fd, now, born);
+        }
+        return Step::DONE;
+    }
+
+    Step on_read_index(TransferSession& s, TransferClock::time_point now) {
+        ssize_t n = recv(s.fd, (char*)&s.net_idx + s.idx_have, sizeof(s.net_idx) - s.idx_have, 0);
+        if (n == 0) return Step::FAIL;
+        if (n < 0) return would_block() ? Step::KEEP : Step::FAIL;
+        s.idx_have += n;
+        if (s.idx_have < sizeof(s.net_idx)) return Step::KEEP;
+
+        DownloadTransfer& d = *s.download;
+        uint32_t idx = ntohl(s.net_idx);
+        if (idx >= (uint32_t)d.streams) return Step::FAIL;
+
+        s.offset = std::min(idx * d.chunk_size, d.blob->size);
+        s.remaining = std::min(d.chunk_size, d.blob->size - s.offset);
+        s.state = TransferSession::State::STREAMING;
+        s.deadline = now + std::chrono::seconds(TRANSFER_IDLE_TIMEOUT_SEC);
+        return Step::KEEP;
+    }
+
+    Step on_stream(TransferSession& s, TransferClock::time_point now) {
+        int flow = s.upload ? s.upload->flow : s.download->flow;
+
+        while (s.remaining > 0) {
+            size_t want = std::min<size_t>(s.remaining, TRANSFER_IO_SLICE);
+            size_t granted = sched.grant(flow, want);
+            if (granted == 0) {
+                s.wake_at = now + sched.wait_hint(flow, want);
+                return Step::KEEP;
+            }
+
+            ssize_t n;
+            if (s.upload) {
+                char buffer[TRANSFER_IO_SLICE];
+                n = recv(s.fd, buffer, granted, 0);
+                if (n > 0) {
+                    if (write(s.upload->part_fd, buffer, n) != n) return Step::FAIL;
+                    s.upload->checksums.update(buffer, n);
+                }
+            } else {
+                n = send(s.fd, s.download->blob->data + s.offset, granted, TRANSFER_SEND_FLAGS);
+            }
+
+            if (n < (ssize_t)granted) sched.refund(flow, granted - std::max<ssize_t>(n, 0));
+            if (n == 0 && s.upload) return Step::FAIL;
+            if (n < 0) return would_block() ? Step::KEEP : Step::FAIL;
+
+            s.offset += n;
+            s.remaining -= n;
+            s.deadline = now + std::chrono::seconds(TRANSFER_IDLE_TIMEOUT_SEC);
+            if (n < (ssize_t)granted) return Step::KEEP;
+        }
+
+        if (s.upload) {
+            s.upload->verify();
+            return s.upload->completed ? Step::DONE : Step::FAIL;
+        }
+        return Step::DONE;
+    }
+
+    void run() {
+        std::vector<struct pollfd> pfds;
+
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(inbox_mutex);
+                for (auto& s : inbox) sessions.push_back(std::move(s));
+                inbox.clear();
+            }
+            active = sessions.size();
+
+            auto now = TransferClock::now();
+            auto next_event = now + std::chrono::seconds(1);
+
+            pfds.clear();
+            pfds.push_back({wake_pipe[0], POLLIN, 0});
+            for (auto& s : sessions) {
+                short events = POLLIN;
+                if (s.state == TransferSession::State::STREAMING && s.download) events = POLLOUT;
+                if (s.wake_at > now) {
+                    events = 0;
+                    next_event = std::min(next_event, s.wake_at);
+                }
+                next_event = std::min(next_event, s.deadline);
+                pfds.push_back({s.fd, events, 0});
+            }
+
+            int timeout_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(next_event - now).count();
+            if (poll(pfds.data(), pfds.size(), std::max(timeout_ms, 1)) < 0 && errno != EINTR) {
+                perror("poll");
+                continue;
+            }
+
+            if (pfds[0].revents & POLLIN) {
+                char drain[64];
+                while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+            }
+
+            now = TransferClock::now();
+            std::vector<TransferSession> kept;
+            kept.reserve(sessions.size());
+
+            for (size_t i = 0; i < sessions.size(); i++) {
+                TransferSession& s = sessions[i];
+                const struct pollfd& p = pfds[i + 1];
+                Step step = Step::KEEP;
+
+                if (p.revents != 0 || (p.events == 0 && s.wake_at <= now)) {
+                    switch (s.state) {
+                        case TransferSession::State::ACCEPTING:  step = on_accept(s, kept, now); break;
+                        case TransferSession::State::READ_INDEX: step = on_read_index(s, now); break;
+                        case TransferSession::State::STREAMING:  step = on_stream(s, now); break;
+                    }
+                }
+
+                if (step == Step::KEEP && now >= s.deadline) {
+                    bool idle_listener = s.state == TransferSession::State::ACCEPTING &&
+                                         (s.upload || s.download->served > 0);
+                    if (!idle_listener) {
+                        std::cerr << "[Error] Transfer timeout." << std::endl;
+                        step = Step::FAIL;
+                    } else {
+                        step = Step::DONE;
+                    }
+                }
+
+                if (step == Step::KEEP) {
+                    kept.push_back(std::move(s));
+                    continue;
+                }
+
+                if (s.state != TransferSession::State::ACCEPTING) {
+                    (step == Step::DONE) ? completed++ : failed++;
+                }
+                ::close(s.fd);
+            }
+
+            sessions.swap(kept);
+        }
+    }
+
+public:
+    explicit TransferReactor(TransferScheduler& s) : sched(s) {
+        if (pipe(wake_pipe) != 0) perror("pipe");
+        set_nonblocking(wake_pipe[0]);
+        set_nonblocking(wake_pipe[1]);
+        worker = std::thread(&TransferReactor::run, this);
+        worker.detach();
+    }
+
+    void submit(TransferSession s) {
+        set_nonblocking(s.fd);
+        s.deadline = TransferClock::now() + std::chrono::seconds(TRANSFER_ACCEPT_TIMEOUT_SEC);
+        s.wake_at = TransferClock::now();
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex);
+            inbox.push_back(std::move(s));
+        }
+        char c = 1;
+        if (write(wake_pipe[1], &c, 1) < 0) {}
+    }
+
+    size_t active_sessions() const { return active; }
+    uint64_t completed_sessions() const { return completed; }
+    uint64_t failed_sessions() const { return failed; }
+};
+
+class TransferPool {
+private:
+    TransferScheduler& sched;
+    std::vector<std::unique_ptr<TransferReactor>> reactors;
+    std::atomic<size_t> next{0};
+
+    TransferReactor& pick() {
+        return *reactors[next++ % reactors.size()];
+    }
+
+public:
+    TransferPool(TransferScheduler& s, int n_reactors) : sched(s) {
+        for (int i = 0; i < std::max(1, n_reactors); i++) {
+            reactors.emplace_back(new TransferReactor(sched));
+        }
+    }
+
+    void start_upload(int listen_fd, const std::string& filepath, size_t filesize, const std::string& user,
+                      const uint32_t* expected_crc, std::function<void(bool, const FileChecksums&)> on_finish) {
+        TransferSession s;
+        s.fd = listen_fd;
+        s.accepts_left = 1;
+        s.upload = std::make_shared<UploadTransfer>(sched, filepath, filesize, user, std::move(on_finish));
+        if (expected_crc) {
+            s.upload->has_expected_crc = true;
+            s.upload->expected_crc = *expected_crc;
+        }
+        pick().submit(std::move(s));
+    }
+
+    void start_download(int listen_fd, std::shared_ptr<const MappedFile> blob, const std::string& filepath,
+                        int streams, size_t chunk_size, const std::string& user, TransferClass cls) {
+        TransferSession s;
+        s.fd = listen_fd;
+        s.accepts_left = streams;
+        s.download = std::make_shared<DownloadTransfer>(sched, std::move(blob), filepath, streams, chunk_size, user, cls);
+        pick().submit(std::move(s));
+    }
+
+    json stats() {
+        size_t active = 0;
+        uint64_t done = 0, failed = 0;
+        for (auto& r : reactors) {
+            active += r->active_sessions();
+            done   += r->completed_sessions();
+            failed += r->failed_sessions();
+        }
+        json s;
+        s["reactors"] = reactors.size();
+        s["active_sessions"] = active;
+        s["completed_streams"] = done;
+        s["failed_streams"] = failed;
+        return s;
+    }
+};
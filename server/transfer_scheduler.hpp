@@ -0,0 +1,183 @@
+#pragma once
+#include "../json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+using json = nlohmann::json;
+
+enum class TransferClass {
+    ROOM_DOWNLOAD,
+    STORE_DOWNLOAD,
+    UPLOAD
+};
+
+inline int transfer_class_weight(TransferClass cls) {
+    switch (cls) {
+        case TransferClass::ROOM_DOWNLOAD:  return 8;
+        case TransferClass::UPLOAD:         return 2;
+        case TransferClass::STORE_DOWNLOAD: return 1;
+    }
+    return 1;
+}
+
+inline const char* transfer_class_name(TransferClass cls) {
+    switch (cls) {
+        case TransferClass::ROOM_DOWNLOAD:  return "room_download";
+        case TransferClass::UPLOAD:         return "upload";
+        case TransferClass::STORE_DOWNLOAD: return "store_download";
+    }
+    return "unknown";
+}
+
+// Weighted fair sharing of one global transfer budget. Every active transfer is a
+// flow whose token bucket refills at its weighted share of the global rate, further
+// split so that one user's flows never exceed the per-user cap together.
+// Lobby control traffic never passes through here, so it is never throttled.
+class TransferScheduler {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t MIN_GRANT   = 4096;
+    static constexpr double BURST_SECS  = 0.05;
+
+    struct Flow {
+        std::string user;
+        TransferClass cls;
+        int weight;
+        double rate = 0;
+        double tokens = 0;
+        Clock::time_point last;
+    };
+
+    struct UserShare {
+        int weight_sum = 0;
+        int flows = 0;
+    };
+
+    double global_bps;
+    double user_bps;
+    int next_id = 1;
+    int total_weight = 0;
+    std::map<int, Flow> flows;
+    std::unordered_map<std::string, UserShare> users;
+    std::mutex sched_mutex;
+
+    uint64_t class_bytes[3] = {0, 0, 0};
+    uint64_t throttle_waits = 0;
+
+    double burst(const Flow& f) const {
+        return std::max<double>(MIN_GRANT, f.rate * BURST_SECS);
+    }
+
+    void refill(Flow& f, Clock::time_point now) {
+        double dt = std::chrono::duration<double>(now - f.last).count();
+        f.tokens = std::min(burst(f), f.tokens + f.rate * dt);
+        f.last = now;
+    }
+
+    void rebalance() {
+        auto now = Clock::now();
+        for (auto& [id, f] : flows) {
+            refill(f, now);
+            double share = global_bps * f.weight / total_weight;
+            double user_share = user_bps * f.weight / users[f.user].weight_sum;
+            f.rate = std::min(share, user_share);
+            f.tokens = std::min(f.tokens, burst(f));
+        }
+    }
+
+public:
+    TransferScheduler(double global_bytes_per_sec, double user_bytes_per_sec)
+        : global_bps(global_bytes_per_sec), user_bps(user_bytes_per_sec) {}
+
+    int open_flow(const std::string& user, TransferClass cls) {
+        std::lock_guard<std::mutex> lock(sched_mutex);
+        int id = next_id++;
+        Flow f;
+        f.user = user;
+        f.cls = cls;
+        f.weight = transfer_class_weight(cls);
+        f.last = Clock::now();
+        flows[id] = f;
+
+        total_weight += f.weight;
+        users[user].weight_sum += f.weight;
+        users[user].flows++;
+        rebalance();
+        return id;
+    }
+
+    void close_flow(int id) {
+        std::lock_guard<std::mutex> lock(sched_mutex);
+        auto it = flows.find(id);
+        if (it == flows.end()) return;
+
+        total_weight -= it->second.weight;
+        UserShare& u = users[it->second.user];
+        u.weight_sum -= it->second.weight;
+        if (--u.flows == 0) users.erase(it->second.user);
+        flows.erase(it);
+
+        if (!flows.empty()) rebalance();
+    }
+
+    // Non-blocking: returns how many of `want` bytes may move now (0 = wait).
+    size_t grant(int id, size_t want) {
+        std::lock_guard<std::mutex> lock(sched_mutex);
+        auto it = flows.find(id);
+        if (it == flows.end()) return want;
+
+        Flow& f = it->second;
+        refill(f, Clock::now());
+        if (f.tokens < (double)std::min(want, MIN_GRANT)) {
+            throttle_waits++;
+            return 0;
+        }
+
+        size_t n = std::min(want, (size_t)f.tokens);
+        f.tokens -= n;
+        class_bytes[(int)f.cls] += n;
+        return n;
+    }
+
+    // Time until `grant` can hand out at least MIN_GRANT bytes to this flow.
+    std::chrono::microseconds wait_hint(int id, size_t want) {
+        std::lock_guard<std::mutex> lock(sched_mutex);
+        auto it = flows.find(id);
+        if (it == flows.end() || it->second.rate <= 0) return std::chrono::microseconds(1000);
+
+        const Flow& f = it->second;
+        double missing = (double)std::min(want, MIN_GRANT) - f.tokens;
+        if (missing <= 0) return std::chrono::microseconds(0);
+        return std::chrono::microseconds((long)(missing / f.rate * 1e6) + 1);
+    }
+
+    // Returns bytes granted by `grant` that could not actually be moved.
+    void refund(int id, size_t n) {
+        std::lock_guard<std::mutex> lock(sched_mutex);
+        auto it = flows.find(id);
+        if (it == flows.end()) return;
+        it->second.tokens += n;
+        class_bytes[(int)it->second.cls] -= n;
+    }
+
+    json stats() {
+        std::lock_guard<std::mutex> lock(sched_mutex);
+        json s;
+        s["global_bps"] = global_bps;
+        s["user_bps"] = user_bps;
+        s["active_flows"] = flows.size();
+        s["active_users"] = users.size();
+        s["throttle_waits"] = throttle_waits;
+        json bytes;
+        for (TransferClass cls : {TransferClass::ROOM_DOWNLOAD, TransferClass::STORE_DOWNLOAD, TransferClass::UPLOAD}) {
+            bytes[transfer_class_name(cls)] = class_bytes[(int)cls];
+        }
+        s["bytes"] = bytes;
+        return s;
+    }
+};
@@ -0,0 +1,300 @@
+#pragma once
+#include "../json.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+// Append-only log of typed mutations, one JSON record per line.
+// Records are group-committed: a writer thread gathers everything enqueued
+// within `window` (or up to `max_batch` records) into one write + fsync, and
+// callers block in wait_durable() until the batch holding their LSN is on disk.
+// A batch that fails to write is cut back off the file and retried; nothing
+// after it is written and no caller is told it is durable meanwhile.
+class WriteAheadLog {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::string path;
+    int fd = -1;
+    std::atomic<size_t> bytes{0};
+
+    std::chrono::microseconds window{2000};
+    size_t max_batch = 256;
+    bool debounce = false;
+
+    std::mutex io_mutex;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::condition_variable durable_cv;
+    std::string pending;
+    size_t pending_records = 0;
+    uint64_t pending_lsn = 0;
+    uint64_t durable_lsn = 0;
+    Clock::time_point first_pending;
+    size_t waiters = 0;
+    bool stopping = false;
+    bool running = false;
+    std::thread writer;
+
+    // End of the last batch known to be on disk; guarded by io_mutex.
+    off_t synced_bytes = 0;
+
+    std::atomic<uint64_t> fsyncs{0};
+    std::atomic<uint64_t> records{0};
+    std::atomic<uint64_t> write_failures{0};
+    std::atomic<bool> failing{false};
+    Clock::time_point started = Clock::now();
+    Clock::time_point last_stats = Clock::now();
+    uint64_t last_stats_fsyncs = 0;
+
+    static bool append_file(const std::string& src, const std::string& dst) {
+        std::ifstream in(src, std::ios::binary);
+        std::ofstream out(dst, std::ios::binary | std::ios::app);
+        if (!in.is_open() || !out.is_open()) return false;
+        out << in.rdbuf();
+        out.flush();
+        return out.good();
+    }
+
+    bool write_bytes(const std::string& data) {
+        const char* p = data.data();
+        size_t left = data.size();
+        while (left > 0) {
+            ssize_t n = ::write(fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                perror("wal write");
+                return false;
+            }
+            p += n;
+            left -= n;
+        }
+        return true;
+    }
+
+    bool sync() {
+        fsyncs++;
+#ifdef __APPLE__
+        return fsync(fd) == 0;
+#else
+        return fdatasync(fd) == 0;
+#endif
+    }
+
+    // Writes and syncs one batch. On failure the partial write is truncated
+    // away, so a retry cannot leave a torn record in the middle of the log.
+    bool write_batch(const std::string& batch) {
+        std::lock_guard<std::mutex> io(io_mutex);
+        if (write_bytes(batch) && sync()) {
+            synced_bytes += batch.size();
+            return true;
+        }
+        if (ftruncate(fd, synced_bytes) != 0) perror("wal truncate");
+        return false;
+    }
+
+    void writer_loop() {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        while (true) {
+            queue_cv.wait(lock, [this] { return pending_records > 0 || stopping; });
+            if (pending_records == 0 && stopping) break;
+
+            // A lone committer (the select lobby's usual case) is flushed at
+            // once. The window is only spent while other committers are
+            // blocked too, so more records can join, or in async mode, where
+            // it is the flush interval.
+            if (debounce || waiters > 1) {
+                queue_cv.wait_until(lock, first_pending + window, [this] {
+                    return pending_records >= max_batch || stopping;
+                });
+            }
+
+            std::string batch;
+            batch.swap(pending);
+            uint64_t batch_lsn = pending_lsn;
+            pending_records = 0;
+            lock.unlock();
+
+            // Later records must not land before this batch, so it is retried
+            // until it sticks; on shutdown the log gives up instead.
+            auto backoff = std::chrono::milliseconds(10);
+            bool written;
+            while (!(written = write_batch(batch))) {
+                write_failures++;
+                failing = true;
+                std::cerr << "Error: WAL write failed for batch ending at LSN " << batch_lsn
+                          << ", retrying in " << backoff.count() << " ms" << std::endl;
+                lock.lock();
+                bool stop = queue_cv.wait_for(lock, backoff, [this] { return stopping; });
+                lock.unlock();
+                if (stop) break;
+                backoff = std::min(backoff * 2, std::chrono::milliseconds(1000));
+            }
+
+            lock.lock();
+            if (!written) {
+                std::cerr << "Error: WAL abandoned unwritten records from LSN " << durable_lsn + 1 << std::endl;
+                break;
+            }
+            failing = false;
+            durable_lsn = batch_lsn;
+            durable_cv.notify_all();
+        }
+        running = false;
+        durable_cv.notify_all();
+    }
+
+public:
+    ~WriteAheadLog() {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+        }
+        queue_cv.notify_all();
+        if (writer.joinable()) writer.join();
+        if (fd >= 0) ::close(fd);
+    }
+
+    // With `always_wait` every batch waits out the window (async durability,
+    // where nobody blocks on it); otherwise only when committers queue up.
+    void configure(std::chrono::microseconds batch_window, size_t batch_records, bool always_wait) {
+        window = batch_window;
+        max_batch = std::max<size_t>(1, batch_records);
+        debounce = always_wait;
+    }
+
+    bool open(const std::string& wal_path, uint64_t recovered_lsn) {
+        path = wal_path;
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) {
+            perror("wal open");
+            return false;
+        }
+        struct stat st;
+        bytes = synced_bytes = (fstat(fd, &st) == 0) ? st.st_size : 0;
+        durable_lsn = pending_lsn = recovered_lsn;
+        running = true;
+        writer = std::thread(&WriteAheadLog::writer_loop, this);
+        return true;
+    }
+
+    // Queues a record; LSNs must be enqueued in increasing order.
+    void enqueue(uint64_t lsn, const json& record) {
+        std::string line = record.dump() + "\n";
+        bytes += line.size();
+        records++;
+
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (pending_records == 0) first_pending = Clock::now();
+        pending += line;
+        pending_records++;
+        pending_lsn = lsn;
+        if (pending_records == 1 || pending_records >= max_batch) queue_cv.notify_one();
+    }
+
+    // False if the log stopped before `lsn` reached the disk.
+    bool wait_durable(uint64_t lsn) {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        waiters++;
+        durable_cv.wait(lock, [&] { return durable_lsn >= lsn || !running; });
+        waiters--;
+        return durable_lsn >= lsn;
+    }
+
+    size_t size_bytes() const { return bytes; }
+
+    // Moves the current log aside so a snapshot can absorb it. If an earlier
+    // compaction never finished, the current log is appended to that one instead.
+    bool rotate(const std::string& old_path) {
+        std::lock_guard<std::mutex> io(io_mutex);
+        struct stat st;
+        if (stat(old_path.c_str(), &st) == 0) {
+            if (!append_file(path, old_path)) return false;
+            if (ftruncate(fd, 0) != 0) return false;
+        } else {
+            if (rename(path.c_str(), old_path.c_str()) != 0) return false;
+            ::close(fd);
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (fd < 0) return false;
+        }
+        bytes = 0;
+        synced_bytes = 0;
+        return true;
+    }
+
+    json stats() {
+        auto now = Clock::now();
+        uint64_t f = fsyncs;
+        double uptime = std::chrono::duration<double>(now - started).count();
+        double since = std::chrono::duration<double>(now - last_stats).count();
+
+        json s;
+        s["records"] = records.load();
+        s["fsyncs"] = f;
+        s["records_per_fsync"] = f ? (double)records / f : 0.0;
+        s["fsync_rate_avg"] = uptime > 0 ? f / uptime : 0.0;
+        s["fsync_rate_recent"] = since > 0 ? (f - last_stats_fsyncs) / since : 0.0;
+        s["wal_bytes"] = bytes.load();
+        s["write_failures"] = write_failures.load();
+        s["failing"] = failing.load();
+        s["window_us"] = window.count();
+        s["max_batch"] = max_batch;
+
+        last_stats = now;
+        last_stats_fsyncs = f;
+        return s;
+    }
+
+    // Calls `apply` for every intact record. With `repair`, a torn tail left by
+    // a crash is cut off so that later appends are not hidden behind it;
+    // otherwise it is only skipped and the file is left as it is.
+    static size_t replay(const std::string& wal_path, const std::function<void(const json&)>& apply,
+                         bool repair = true) {
+        std::ifstream in(wal_path, std::ios::binary);
+        std::string line;
+        size_t count = 0;
+        off_t good_bytes = 0;
+        bool torn = false;
+
+        while (std::getline(in, line)) {
+            if (in.eof()) {
+                torn = true;
+                break;
+            }
+            if (!line.empty()) {
+                json rec;
+                try {
+                    rec = json::parse(line);
+                } catch (...) {
+                    torn = true;
+                    break;
+                }
+                apply(rec);
+                count++;
+            }
+            good_bytes += line.size() + 1;
+        }
+
+        if (torn && repair) {
+            std::cerr << "Warning: WAL " << wal_path << " has a torn record, truncating." << std::endl;
+            in.close();
+            if (truncate(wal_path.c_str(), good_bytes) != 0) perror("wal truncate");
+        } else if (torn) {
+            std::cerr << "Warning: WAL " << wal_path << " has a torn record, ignoring it." << std::endl;
+        }
+        return count;
+    }
+};
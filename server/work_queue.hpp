@@ -0,0 +1,60 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// One background thread running posted jobs in order, for slow work such as
+// compressing an uploaded game that must not stall the lobby or a transfer
+// reactor. Jobs still queued when the queue is destroyed run before it returns.
+class WorkQueue {
+private:
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<std::function<void()>> jobs;
+    bool stopping = false;
+    std::thread worker;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        while (true) {
+            queue_cv.wait(lock, [this] { return !jobs.empty() || stopping; });
+            if (jobs.empty()) return;
+
+            std::function<void()> job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+            job();
+            lock.lock();
+        }
+    }
+
+public:
+    WorkQueue() : worker(&WorkQueue::run, this) {}
+
+    WorkQueue(const WorkQueue&) = delete;
+    WorkQueue& operator=(const WorkQueue&) = delete;
+
+    ~WorkQueue() {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+        }
+        queue_cv.notify_one();
+        if (worker.joinable()) worker.join();
+    }
+
+    void post(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            jobs.push_back(std::move(job));
+        }
+        queue_cv.notify_one();
+    }
+
+    size_t pending() {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        return jobs.size();
+    }
+};